@@ -7,21 +7,490 @@
 #ifndef AVL_HPP_
 #define AVL_HPP_
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "AVLCodec.hpp"
+
+/* Statements, which only collect statistics (see AVLStats). */
+#ifdef AVL_ENABLE_STATS
+#define AVL_STATS(...) __VA_ARGS__
+#else
+#define AVL_STATS(...)
+#endif
+
+/* Augmentation policies.
+ * Augmented tree keeps in each node an aggregate of its whole subtree, which
+ * allows answering range queries in O(log(n)). Aggregates are combined with
+ * an associative operation (i.e. policy is a monoid), which doesn't have to
+ * be commutative - operands are always passed in in-order.
+ *
+ * @Requirements from policy:
+ *     value_type - type of the aggregate, copy-constructible, assignable.
+ *     static value_type identity() - neutral element of combine.
+ *     static value_type lift(const Key&, const Value&) - aggregate of a
+ *         single item.
+ *     static value_type combine(const value_type&, const value_type&) -
+ *         associative operation, left operand holds the smaller keys.
+ */
+
+/* Default policy, no aggregate is stored in nodes. */
+struct NoAugment {
+	struct value_type {};
+};
+
+/* Sum of values. Value must be convertible to T. */
+template<typename T>
+struct SumAugment {
+	typedef T value_type;
+	static T identity() {
+		return T();
+	}
+	template<typename Key, typename Value>
+	static T lift(const Key&, const Value& v) {
+		return v;
+	}
+	static T combine(const T& a, const T& b) {
+		return a + b;
+	}
+};
+
+/* Minimum of values. Value must be convertible to T. */
+template<typename T>
+struct MinAugment {
+	typedef T value_type;
+	static T identity() {
+		return std::numeric_limits<T>::max();
+	}
+	template<typename Key, typename Value>
+	static T lift(const Key&, const Value& v) {
+		return v;
+	}
+	static T combine(const T& a, const T& b) {
+		return b < a ? b : a;
+	}
+};
+
+/* Maximum of values. Value must be convertible to T. */
+template<typename T>
+struct MaxAugment {
+	typedef T value_type;
+	static T identity() {
+		return std::numeric_limits<T>::lowest();
+	}
+	template<typename Key, typename Value>
+	static T lift(const Key&, const Value& v) {
+		return v;
+	}
+	static T combine(const T& a, const T& b) {
+		return a < b ? b : a;
+	}
+};
+
+/* Number of items, i.e. subtree sizes. */
+struct CountAugment {
+	typedef int value_type;
+	static int identity() {
+		return 0;
+	}
+	template<typename Key, typename Value>
+	static int lift(const Key&, const Value&) {
+		return 1;
+	}
+	static int combine(int a, int b) {
+		return a + b;
+	}
+};
+
+/* Node layout policies.
+ * ParentLinks - each node links to its parent. Iterator is a single pointer,
+ *     and steps upwards by the links.
+ * AncestorStack - nodes have no parent link: a pointer less per node, and no
+ *     parent fixups in rolls and other relinking. Iterator carries a stack
+ *     of ancestors instead (fixed-size, as height of AVL tree is below
+ *     1.45*log2(n + 2)), so it's larger, and slower to copy.
+ * Rebalancing doesn't depend on layout: insert_r/unlink_r rebalance on the
+ * way back from recursion, i.e. along the explicit search path.
+ */
+struct ParentLinks {};
+struct AncestorStack {};
+
+/* Balancing policies.
+ * AVLBalance - heights of sibling subtrees differ by 1 at most. Removal
+ *     may roll at every level of the path, O(log(n)) rolls.
+ * WAVLBalance - weak AVL (rank-balanced) tree. Nodes keep ranks instead of
+ *     heights: rank differences of node and its children are 1 or 2, and
+ *     leaves have rank 0. Trees built by insertions only are AVL trees, but
+ *     removal makes at most 2 rolls, and O(1) amortized rank changes. Height
+ *     is below 2*log2(n), and below 1.45*log2(m) after m insertions.
+ */
+struct AVLBalance {
+	enum { ranked = false };
+};
+struct WAVLBalance {
+	enum { ranked = true };
+};
+
 /* Auxiliary functions, unrelated to AVL tree class.
  * Separate namespace to avoid names collision. */
 namespace aux {
+/* Empty type, e.g. value of a set. */
+struct none {};
+
+/* Predicate of AVL::merge_except(), which skips no keys. */
+struct skip_none {
+	template<typename Key>
+	bool operator()(const Key&) const {
+		return false;
+	}
+};
+
 static int max(int x, int y) {
 	return x < y ? y : x;
 }
 
+/* Keys, which are compared cheaply and without side effects (integral,
+ * floating point, enum and pointer types), so searches may compare them
+ * at every level unconditionally, and select children without branches.
+ * May be specialized for other such key types.
+ */
+template<typename Key>
+struct branchless_search : std::is_scalar<Key> {};
+
 template<typename T>
 static void swap(T& a, T& b) {
 	T tmp(a);
 	a = b;
 	b = tmp;
 }
+
+/* Storage of subtree aggregate in tree nodes. Nodes inherit it, so for
+ * NoAugment it takes no space (empty base optimization).
+ * update() recalculates aggregate of node r from its item and its children.
+ */
+template<typename Augment>
+struct augment_slot {
+	typename Augment::value_type aggregate;
+
+	template<typename Node>
+	static void update(Node* r) {
+		typename Augment::value_type a = Augment::lift(r->key, *(r->value));
+		if (r->left)
+			a = Augment::combine(r->left->aggregate, a);
+		if (r->right)
+			a = Augment::combine(a, r->right->aggregate);
+		r->aggregate = a;
+	}
+};
+
+template<>
+struct augment_slot<NoAugment> {
+	template<typename Node>
+	static void update(Node*) {}
+};
+
+/* Parent link of tree nodes, by layout policy. Nodes inherit it, so for
+ * AncestorStack it takes no space, and set() does nothing.
+ */
+template<typename Layout, typename Node>
+struct parent_slot {
+	Node* parent;
+	parent_slot() : parent(NULL) {}
+	static void set(Node* n, Node* parent) {
+		n->parent = parent;
+	}
+	static Node* get(Node* n) {
+		return n->parent;
+	}
+};
+
+template<typename Node>
+struct parent_slot<AncestorStack, Node> {
+	static void set(Node*, Node*) {}
+	static Node* get(Node*) {
+		return NULL;
+	}
+};
+
+/* Ancestors of iterator's node, whose left subtree contains it (i.e. nodes
+ * next in-order after the node and its right subtree), nearest on top.
+ * ParentLinks iterators don't need them, so they keep nothing.
+ */
+template<typename Layout, typename Node>
+struct ancestors {
+	enum { needed = false };
+	void push(Node*) {}
+	int size() const {
+		return 0;
+	}
+	void truncate(int) {}
+};
+
+template<typename Node>
+struct ancestors<AncestorStack, Node> {
+	enum {
+		needed = true,
+		// Enough for any tree with less than 2^31 nodes, with any balancing.
+		CAPACITY = 64
+	};
+	Node* nodes[CAPACITY];
+	int count;
+	ancestors() : count(0) {}
+	void push(Node* n) {
+		assert(count < CAPACITY);
+		nodes[count++] = n;
+	}
+	Node* pop() {
+		return count ? nodes[--count] : NULL;
+	}
+	int size() const {
+		return count;
+	}
+	void truncate(int size) {
+		count = size;
+	}
+};
+
+/* Whether std::move_if_noexcept moves an object of type T (rather than
+ * copies it).
+ */
+template<typename T>
+struct moved_if_noexcept {
+	static const bool value = std::is_nothrow_move_constructible<T>::value
+			|| !std::is_copy_constructible<T>::value;
+};
+
+/* Blocks of memory, each holding many objects of same size, e.g. nodes
+ * relocated by AVL::compact(). Objects are released one by one, and chunk
+ * is freed with its last object. Chunks are aligned to their size, which
+ * depends only on the object size, so chunk of an object is found by its
+ * address: objects need no pointer to their chunk, and release takes no
+ * lock.
+ */
+class slabs {
+	struct header {
+		std::atomic<size_t> live;
+		size_t objects;
+	};
+
+	enum { MIN_CHUNK_SIZE = 1 << 16 };
+
+	static size_t header_size() {
+		const size_t align = alignof(std::max_align_t);
+		return (sizeof(header) + align - 1) / align * align;
+	}
+	/* Size (and alignment) of chunks for objects of object_size bytes. */
+	static size_t chunk_size(size_t object_size) {
+		size_t size = MIN_CHUNK_SIZE;
+		while (size < header_size() + object_size) {
+			size *= 2;
+		}
+		return size;
+	}
+	static header* header_of(const void* object, size_t object_size) {
+		return reinterpret_cast<header*>(reinterpret_cast<uintptr_t>(object)
+				& ~(uintptr_t) (chunk_size(object_size) - 1));
+	}
+
+public:
+	/* Places count objects of object_size bytes one after another, in as
+	 * few chunks as possible.
+	 */
+	class slab {
+		size_t object_size, left, in_chunk;
+		char* next;
+
+	public:
+		slab(size_t object_size, size_t count) :
+				object_size(object_size),
+				left(count),
+				in_chunk(0),
+				next(NULL) {}
+
+		/* @Return: memory for the next object.
+		 * @Time complexity: O(1)
+		 */
+		void* allocate() {
+			assert(left > 0);
+			if (!in_chunk) {
+				size_t size = chunk_size(object_size);
+				in_chunk = (size - header_size()) / object_size;
+				in_chunk = in_chunk < left ? in_chunk : left;
+				void* chunk = NULL;
+				if (posix_memalign(&chunk, size,
+						header_size() + in_chunk * object_size) != 0)
+					throw std::bad_alloc();
+				header* h = new (chunk) header();
+				h->live.store(in_chunk, std::memory_order_relaxed);
+				h->objects = in_chunk;
+				next = static_cast<char*>(chunk) + header_size();
+			}
+			--left;
+			--in_chunk;
+			void* object = next;
+			next += object_size;
+			return object;
+		}
+
+		/* Gives up the objects, which weren't allocated yet (e.g. when
+		 * relocation failed midway), so the chunks are freed with the
+		 * allocated ones.
+		 * @Time complexity: O(1)
+		 */
+		void release_unused() {
+			if (in_chunk) {
+				header* h = header_of(next, object_size);
+				if (h->live.fetch_sub(in_chunk, std::memory_order_acq_rel)
+						== in_chunk) {
+					h->~header();
+					std::free(h);
+				}
+			}
+			left = 0;
+			in_chunk = 0;
+			next = NULL;
+		}
+	};
+
+	/* Releases memory of a single (already destroyed) object.
+	 * @Time complexity: O(1)
+	 */
+	static void release(const void* object, size_t object_size) {
+		header* h = header_of(object, object_size);
+		if (h->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			h->~header();
+			std::free(h);
+		}
+	}
+
+	/* Unused bytes of chunk of object (i.e. of released objects), divided
+	 * between its live objects.
+	 */
+	static size_t slack(const void* object, size_t object_size) {
+		const header* h = header_of(object, object_size);
+		size_t live = h->live.load(std::memory_order_relaxed);
+		return (h->objects - live) * object_size / live;
+	}
+};
+
+/* Allocator overhead of separately allocated object of given size:
+ * rounding up and chunk header (estimated, unless allocator reports it).
+ */
+inline size_t heap_slack(const void* object, size_t size) {
+#ifdef __GLIBC__
+	return malloc_usable_size(const_cast<void*>(object)) - size + sizeof(size_t);
+#else
+	(void) object;
+	return (size + sizeof(size_t) + 15) / 16 * 16 - size;
+#endif
+}
+
+/* Runs f in a new thread and g in this one, and waits for both.
+ * Exception of either one is rethrown (of g, if both threw).
+ */
+template<typename F, typename G>
+void fork_join(F f, G g) {
+	std::exception_ptr error;
+	std::thread worker([&f, &error]() {
+		try {
+			f();
+		} catch (...) {
+			error = std::current_exception();
+		}
+	});
+	try {
+		g();
+	} catch (...) {
+		worker.join();
+		throw;
+	}
+	worker.join();
+	if (error)
+		std::rethrow_exception(error);
 }
 
+/* Ranges of less items, and subtrees of less height, aren't split between
+ * threads. */
+enum {
+	PARALLEL_GRAIN = 1 << 14,
+	PARALLEL_HEIGHT = 16
+};
+
+/* Stable sort of [first, last) by up to given number of threads: halves
+ * are sorted in parallel, and then merged.
+ * @Time complexity: O(p*log(p)/t + p), where p is size of the range.
+ * @Memory complexity: O(p)
+ */
+template<typename RandomIt, typename Less>
+void parallel_stable_sort(RandomIt first, RandomIt last, Less less,
+		unsigned threads) {
+	if (threads <= 1 || last - first <= PARALLEL_GRAIN) {
+		std::stable_sort(first, last, less);
+		return;
+	}
+	RandomIt mid = first + (last - first) / 2;
+	fork_join([=]() {
+		parallel_stable_sort(first, mid, less, threads / 2);
+	}, [=]() {
+		parallel_stable_sort(mid, last, less, threads - threads / 2);
+	});
+	std::inplace_merge(first, mid, last, less);
+}
+}
+
+/* Memory, used by a tree (see AVL::memory_usage()), in bytes. */
+struct AVLMemoryUsage {
+	size_t nodes; // node objects, including keys
+	size_t values; // value objects (not memory they own, e.g. of strings)
+	size_t slack; // allocator overhead and unused space
+	size_t total() const {
+		return nodes + values + slack;
+	}
+};
+
+/* Orders of nodes in memory, made by AVL::compact(). */
+enum CompactOrder {
+	COMPACT_INORDER, // ascending keys, for scans
+	COMPACT_VEB // van Emde Boas, for searches
+};
+
+/* Statistics of tree operations, for diagnosis of latency: how much of it
+ * is rebalancing, comparisons or allocation.
+ * Collected only when AVL_ENABLE_STATS is defined, see AVL::stats().
+ * Otherwise nothing is counted, and there is no overhead at all.
+ *
+ * Work is attributed to the public operation it's done for: find (and
+ * bounds), insert, remove (and extract), or other - everything else, e.g.
+ * merge, split and join, and operations of derived trees.
+ * Comparisons and visited nodes are counted in searches for a key (in find,
+ * insert and remove), so visited[op] / operations[op] is the average path.
+ */
+struct AVLStats {
+	enum Operation { FIND, INSERT, REMOVE, OTHER, OPERATIONS };
+	enum Roll { LL, RR, LR, RL, ROLLS };
+
+	unsigned long long operations[OPERATIONS]; // calls, 0 for OTHER
+	unsigned long long rolls[OPERATIONS][ROLLS];
+	unsigned long long comparisons[OPERATIONS];
+	unsigned long long visited[OPERATIONS];
+	unsigned long long allocations; // of nodes
+	unsigned long long frees; // of nodes
+};
+
 /* AVL binary search tree.
  * Supports 'for' ranged loops traversal. In-order used, i.e. items will be
  * sorted in ascending (according to key operator< definition) order.
@@ -37,39 +506,216 @@ static void swap(T& a, T& b) {
  * @Requirements from Value: Copy-constructible. Don't have to be default
  *     constructible.
  *
+ * @Augment: optional augmentation policy (see above), e.g. SumAugment<int>.
+ *     Enables aggregate() queries, for the cost of O(1) extra work in each
+ *     node update.
+ * @Layout: node layout policy (see above), ParentLinks or AncestorStack.
+ * @Balance: balancing policy (see above), AVLBalance or WAVLBalance.
+ *
  * For each function, if not defined otherwise, n is number of nodes in tree,
  * and memory complexity is O(1)
  */
-template<typename Key, typename Value>
+template<typename Key, typename Value, typename Augment = NoAugment,
+		typename Layout = ParentLinks, typename Balance = AVLBalance>
 class AVL {
 
-	struct Node {
+protected:
+	struct Node : aux::augment_slot<Augment>, aux::parent_slot<Layout, Node> {
 		Key key;
 		Value* value;
 		int height;
-		Node *left, *right, *parent;
+		bool pooled, value_pooled; // placed in slab by compact()
+		Node *left, *right;
 		Node(const Key& key, const Value& value) :
 				key(key),
 				value(NULL),
 				height(0),
+				pooled(false),
+				value_pooled(false),
 				left(NULL),
-				right(NULL),
-				parent(NULL) {
+				right(NULL) {
 			this->value = new Value(value);
+			AVL_STATS(count(counters().allocations));
+		}
+		/* Node of given key, which takes ownership of value. */
+		Node(const Key& key, Value* value) :
+				key(key),
+				value(value),
+				height(0),
+				pooled(false),
+				value_pooled(false),
+				left(NULL),
+				right(NULL) {
+			AVL_STATS(count(counters().allocations));
+		}
+		/* Relocation of node n to a slab, with its value already relocated
+		 * to pooled_value. Links aren't copied. Key is copied, if its move
+		 * may throw, so n stays intact if this throws.
+		 */
+		Node(Node& n, Value* pooled_value) :
+				aux::augment_slot<Augment>(n),
+				key(std::move_if_noexcept(n.key)),
+				value(pooled_value),
+				height(n.height),
+				pooled(true),
+				value_pooled(true),
+				left(NULL),
+				right(NULL) {
+			AVL_STATS(count(counters().allocations));
 		}
 //		Node(const Node&) = delete;
 //		Node& operator=(const Node&) = delete;
 		~Node() {
-			delete value;
+			if (value_pooled) {
+				value->~Value();
+				aux::slabs::release(value, sizeof(Value));
+			} else {
+				delete value;
+			}
+			AVL_STATS(count(counters().frees));
 		}
 	};
 
+	/* Frees node, allocated either separately, or in a slab.
+	 * @Time complexity: O(1)
+	 */
+	static void free_node(Node* n) {
+		if (n && n->pooled) {
+			n->~Node();
+			aux::slabs::release(n, sizeof(Node));
+		} else {
+			delete n;
+		}
+	}
+
+	/* Moves value of relocated node back to old node, if it was moved
+	 * (rather than copied) from there.
+	 * @Time complexity: O(1)
+	 */
+	static void restore_value(Node* old, Value* relocated) {
+		if (aux::moved_if_noexcept<Value>::value) {
+			old->value->~Value();
+			new (old->value) Value(std::move(*relocated));
+		}
+	}
+
+	/* Relocates item of node old to a new node in node_slab, with value in
+	 * value_slab. Old node is left intact if this throws.
+	 * @Return: the relocated node, without links.
+	 * @Time complexity: O(1)
+	 */
+	static Node* relocate(Node* old, aux::slabs::slab& node_slab,
+			aux::slabs::slab& value_slab) {
+		void* node_slot = node_slab.allocate();
+		void* value_slot = NULL;
+		Value* value = NULL;
+		try {
+			value_slot = value_slab.allocate();
+			value = new (value_slot) Value(
+					std::move_if_noexcept(*(old->value)));
+			return new (node_slot) Node(*old, value);
+		} catch (...) {
+			if (value) {
+				restore_value(old, value);
+				value->~Value();
+			}
+			if (value_slot)
+				aux::slabs::release(value_slot, sizeof(Value));
+			aux::slabs::release(node_slot, sizeof(Node));
+			throw;
+		}
+	}
+
+	/* Undoes relocate(): moves key and value back to node old, if they were
+	 * moved, and frees the relocated node.
+	 * @Time complexity: O(1)
+	 */
+	static void unrelocate(Node* old, Node* relocated) {
+		if (aux::moved_if_noexcept<Key>::value) {
+			old->key.~Key();
+			new (&old->key) Key(std::move(relocated->key));
+		}
+		restore_value(old, relocated->value);
+		free_node(relocated);
+	}
+
 	Node *root;
 
+#ifdef AVL_ENABLE_STATS
+	/* Counters of AVLStats, shared by all trees of this type. Trees may be
+	 * used from different threads, so counters are atomic, but need no
+	 * ordering.
+	 */
+	typedef std::atomic<unsigned long long> counter;
+	struct statsCounters {
+		counter operations[AVLStats::OPERATIONS];
+		counter rolls[AVLStats::OPERATIONS][AVLStats::ROLLS];
+		counter comparisons[AVLStats::OPERATIONS];
+		counter visited[AVLStats::OPERATIONS];
+		counter allocations;
+		counter frees;
+	};
+
+	static statsCounters& counters() {
+		static statsCounters c;
+		return c;
+	}
+
+	static void count(counter& c) {
+		c.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/* Public operation in progress in this thread, or -1 if there is none. */
+	static int& current_operation() {
+		static thread_local int operation = -1;
+		return operation;
+	}
+
+	/* Operation to attribute current work to. */
+	static int operation() {
+		int op = current_operation();
+		return op < 0 ? AVLStats::OTHER : op;
+	}
+
+	/* Marks public operation op in progress, for its lifetime. Operations
+	 * called by another one (e.g. by operations of derived containers) are
+	 * attributed to the outer one.
+	 */
+	class statsScope {
+		int saved;
+
+	public:
+		explicit statsScope(int op) : saved(current_operation()) {
+			if (saved < 0) {
+				current_operation() = op;
+				count(counters().operations[op]);
+			}
+		}
+		~statsScope() {
+			current_operation() = saved;
+		}
+	};
+#endif
+
+public:
+	/* Type of subtree aggregate, defined by augmentation policy. */
+	typedef typename Augment::value_type aggregate_type;
+
+protected:
+
+	typedef aux::ancestors<Layout, Node> ancestors;
+
+	// Nodes keep WAVL ranks in height, rather than heights.
+	enum { ranked = Balance::ranked };
+
 	class inorderIterator {
-		friend class AVL<Key, Value> ;
+		friend class AVL;
 		Node *node;
+		ancestors path;
 		inorderIterator(Node* node = NULL) :	node(node) {}
+		inorderIterator(Node* node, const ancestors& path) :
+				node(node),
+				path(path) {}
 
 	public:
 
@@ -80,7 +726,7 @@ class AVL {
 		 *     takes O(n) time.
 		 */
 		inorderIterator& operator++() {
-			node = next_inorder(node);
+			node = next_inorder(node, path);
 			return *this;
 		}
 		/* Postfix version. */
@@ -118,10 +764,108 @@ class AVL {
 		}
 	};
 
+	/* Owner of a single node, unlinked from a tree (see extract()).
+	 * Handle can only be moved. Node is freed with the handle, unless it was
+	 * linked back into a tree by insert().
+	 */
+	class nodeHandle {
+		friend class AVL;
+		Node *node;
+		explicit nodeHandle(Node* node) : node(node) {}
+
+	public:
+		nodeHandle() : node(NULL) {}
+		nodeHandle(nodeHandle&& h) : node(h.node) {
+			h.node = NULL;
+		}
+		nodeHandle& operator=(nodeHandle&& h) {
+			if (this != &h) {
+				free_node(node);
+				node = h.node;
+				h.node = NULL;
+			}
+			return *this;
+		}
+		nodeHandle(const nodeHandle&) = delete;
+		nodeHandle& operator=(const nodeHandle&) = delete;
+		~nodeHandle() {
+			free_node(node);
+		}
+
+		/* Checks whether handle owns a node. */
+		bool empty() const {
+			return !node;
+		}
+
+		/* !IMPORTANT! handle must not be empty.
+		 * Returns accessible reference to key, which can be changed before
+		 * inserting node back (i.e. re-keying).
+		 */
+		Key& key() const {
+			return node->key;
+		}
+		/* !IMPORTANT! handle must not be empty.
+		 * Returns accessible reference to value. */
+		Value& value() const {
+			return *(node->value);
+		}
+	};
+
+	/* Takes node out of handle h, for use in derived trees.
+	 * @Return: owned node, or NULL if h is empty.
+	 * @Time complexity: O(1)
+	 */
+	static Node* release(nodeHandle& h) {
+		Node* n = h.node;
+		h.node = NULL;
+		return n;
+	}
+
+	/* Wraps node n, which doesn't belong to any tree, into a handle, for use
+	 * in derived trees.
+	 * @Time complexity: O(1)
+	 */
+	static nodeHandle handle_of(Node* n) {
+		return nodeHandle(n);
+	}
+
+	/* Wraps node into iterator, for use in derived trees.
+	 * Only for ParentLinks layout, where iterator is just the node.
+	 * @Time complexity: O(1)
+	 */
+	static inorderIterator iterator_at(Node* node) {
+		static_assert(!ancestors::needed, "iterator_at() needs parent links");
+		return inorderIterator(node);
+	}
+
+	/* Same as above, for any layout: path holds the ancestors of node (see
+	 * aux::ancestors), e.g. collected by find_path() or bound().
+	 * @Time complexity: O(1)
+	 */
+	static inorderIterator iterator_at(Node* node, const ancestors& path) {
+		return inorderIterator(node, path);
+	}
+
+	/* Sets parent link of n (nothing for AncestorStack layout).
+	 * @Time complexity: O(1)
+	 */
+	static void set_parent(Node* n, Node* parent) {
+		aux::parent_slot<Layout, Node>::set(n, parent);
+	}
+	static Node* parent_of(Node* n) {
+		return aux::parent_slot<Layout, Node>::get(n);
+	}
+
 	/* Test of keys equality, doesn't require == operator.
 	 */
 	static bool equal(const Key& k1, const Key& k2) {
-		return !(k1 < k2 || k2 < k1);
+		return !(less(k1, k2) || less(k2, k1));
+	}
+
+	/* Keys comparison in searches, k1 < k2. Counted in statistics. */
+	static bool less(const Key& k1, const Key& k2) {
+		AVL_STATS(count(counters().comparisons[operation()]));
+		return k1 < k2;
 	}
 
 	/* Calculates actual height, based on subtrees of r.
@@ -137,6 +881,34 @@ class AVL {
 				r->left ? r->left->height : -1) + 1;
 	}
 
+	/* Stored height of r, or rank for WAVLBalance, which isn't less than
+	 * actual height. -1 for empty subtree.
+	 * @Time complexity: O(1)
+	 */
+	static int rank(Node* r) {
+		return r ? r->height : -1;
+	}
+
+	/* Recalculates properties of r, which depend on its subtrees: height and
+	 * aggregate (for augmented trees). Assumes r isn't null.
+	 * Ranks of WAVLBalance aren't recalculated, rebalancing changes them.
+	 * @Time complexity: O(1)
+	 */
+	static void update(Node* r) {
+		if (!ranked)
+			r->height = height(r);
+		aux::augment_slot<Augment>::update(r);
+	}
+
+	/* Same as update(), also for ranks. For nodes of trees built bottom-up,
+	 * where actual heights are valid ranks.
+	 * @Time complexity: O(1)
+	 */
+	static void update_built(Node* r) {
+		r->height = height(r);
+		aux::augment_slot<Augment>::update(r);
+	}
+
 	/* Balance fator in AVL trees is defined as following:
 	 * height(left_child) - height(right_child)
 	 * Assumes node isn't null.
@@ -168,9 +940,9 @@ class AVL {
 	 * @Time complexity: O(1)
 	 */
 	static bool is_leftchild(Node *r) {
-		if (!r || !r->parent)
+		if (!r || !parent_of(r))
 			return false;
-		return r->parent->left == r;
+		return parent_of(r)->left == r;
 	}
 
 	/* Given some node returns it leftmost successor, or node itself,
@@ -190,20 +962,69 @@ class AVL {
 	}
 
 	/* Tree in-order traversal. Given node returns pointer to next one in-order.
-	 * Assumes node isn't null.
+	 * Assumes node isn't null. With AncestorStack layout, path holds the
+	 * ancestors of node (see aux::ancestors), and is updated for the next one.
 	 *
 	 * @Return: pointer to next node in-order
 	 * @Time complexity: O(log(n)) in worst case, but full traversal
 	 *     takes O(n) time.
 	 */
-	static Node* next_inorder(Node* node) {
+	static Node* next_inorder(Node* node, aux::ancestors<ParentLinks, Node>&) {
 		assert(node);
 		if (node->right)
 			return leftmost(node->right);
-		while (!is_leftchild(node) && node->parent) {
-			node = node->parent;
+		while (!is_leftchild(node) && parent_of(node)) {
+			node = parent_of(node);
+		}
+		return parent_of(node);
+	}
+
+	static Node* next_inorder(Node* node,
+			aux::ancestors<AncestorStack, Node>& path) {
+		assert(node);
+		if (!node->right)
+			return path.pop();
+		node = node->right;
+		while (node->left) {
+			path.push(node);
+			node = node->left;
+		}
+		return node;
+	}
+
+	/* Finds the way from root r down to its node n, without comparing keys
+	 * (so among equal keys it's n itself, which is found).
+	 * Bit i of the result is set if step i (from the root) goes right.
+	 * ParentLinks walk up from n, AncestorStack descends from r, turning
+	 * left exactly at the nodes of n's ancestors path.
+	 *
+	 * @Return: steps to n, depth of n is returned through depth.
+	 * @Time complexity: O(log(n))
+	 */
+	static unsigned long long steps_to(Node* n, Node*, int& depth,
+			const aux::ancestors<ParentLinks, Node>&) {
+		unsigned long long steps = 0;
+		for (depth = 0; parent_of(n); n = parent_of(n), ++depth) {
+			steps = steps << 1 | !is_leftchild(n);
 		}
-		return node->parent;
+		return steps;
+	}
+
+	static unsigned long long steps_to(Node* n, Node* r, int& depth,
+			const aux::ancestors<AncestorStack, Node>& path) {
+		unsigned long long steps = 0;
+		int turn = 0; // bottom of the path is the nearest to root
+		for (depth = 0; r != n; ++depth) {
+			assert(r);
+			if (turn < path.size() && path.nodes[turn] == r) {
+				++turn;
+				r = r->left;
+			} else {
+				steps |= 1ULL << depth;
+				r = r->right;
+			}
+		}
+		return steps;
 	}
 
 	/* Decides which type of roll to apply, if needed.
@@ -214,16 +1035,22 @@ class AVL {
 	 * @Time complexity: O(1)
 	 */
 	static Node* check_and_roll(Node* r) {
+		if (ranked)
+			return check_ranks_and_roll(r);
 		if (balance(r) > 1) {
 			if (balance(r->left) >= 0) {
+				AVL_STATS(count(counters().rolls[operation()][AVLStats::LL]));
 				return LL_roll(r);
 			} else {
+				AVL_STATS(count(counters().rolls[operation()][AVLStats::LR]));
 				return LR_roll(r);
 			}
 		} else if (balance(r) < -1) {
 			if (balance(r->right) <= 0) {
+				AVL_STATS(count(counters().rolls[operation()][AVLStats::RR]));
 				return RR_roll(r);
 			} else {
+				AVL_STATS(count(counters().rolls[operation()][AVLStats::RL]));
 				return RL_roll(r);
 			}
 		} else {
@@ -231,21 +1058,88 @@ class AVL {
 		}
 	}
 
-	/* Changes child node of parent of given old_child node.
-	 * For nodes with no parent (i.e. root) does nothing.
-	 * Assumes old_child isn't null.
-	 * Used when swapping nodes in tree (e.g. rolls).
+	/* Same as check_and_roll(), for WAVLBalance. Children of r may violate
+	 * rank rules after insertion (0-child, i.e. of the same rank as r),
+	 * or removal (3-child, or r is a leaf of rank 1) below them.
+	 * Insertion promotes r, or fixes ranks by 1-2 rolls. Removal demotes r,
+	 * or fixes ranks by 1-2 rolls, and then the rest of the path is valid.
+	 *
+	 * @Return: updated root of rebalanced sub-tree.
 	 * @Time complexity: O(1)
 	 */
-	static void set_child_of_parent(Node* old_child, Node* new_child) {
-		assert(old_child);
-		if (old_child->parent) {
-			if (is_leftchild(old_child)) {
-				old_child->parent->left = new_child;
-			} else {
-				old_child->parent->right = new_child;
-			}
+	static Node* check_ranks_and_roll(Node* r) {
+		int left_diff = r->height - rank(r->left);
+		int right_diff = r->height - rank(r->right);
+		if (!left_diff || !right_diff) {
+			return rank_insert_fix(r, !left_diff, left_diff + right_diff);
+		} else if (left_diff == 3 || right_diff == 3) {
+			return rank_remove_fix(r, left_diff == 3, left_diff + right_diff - 3);
+		} else if (left_diff == 2 && right_diff == 2 && is_leaf(r)) {
+			--r->height;
+		}
+		return r;
+	}
+
+	/* r has 0-child on the left (or right) side, and its sibling is 1-child
+	 * or 2-child (sibling_diff). After join() the 0-child may be 1,1 node,
+	 * otherwise it's 1,2 node.
+	 */
+	static Node* rank_insert_fix(Node* r, bool left, int sibling_diff) {
+		if (sibling_diff == 1) {
+			++r->height;
+			return r;
 		}
+		Node* x = left ? r->left : r->right;
+		int outer_diff = x->height - rank(left ? x->left : x->right);
+		int inner_diff = x->height - rank(left ? x->right : x->left);
+		if (inner_diff == 2 || outer_diff == 1) {
+			if (inner_diff == 2)
+				--r->height;
+			else
+				++x->height; // 1,1 node, after join()
+			AVL_STATS(count(counters().rolls[operation()][
+					left ? AVLStats::LL : AVLStats::RR]));
+			return left ? LL_roll(r) : RR_roll(r);
+		}
+		Node* y = left ? x->right : x->left;
+		++y->height;
+		--x->height;
+		--r->height;
+		AVL_STATS(count(counters().rolls[operation()][
+				left ? AVLStats::LR : AVLStats::RL]));
+		return left ? LR_roll(r) : RL_roll(r);
+	}
+
+	/* r has 3-child on the left (or right) side, and its sibling is 1-child
+	 * or 2-child (sibling_diff).
+	 */
+	static Node* rank_remove_fix(Node* r, bool left, int sibling_diff) {
+		--r->height;
+		if (sibling_diff == 2)
+			return r;
+		Node* y = left ? r->right : r->left;
+		int outer_diff = y->height - rank(left ? y->right : y->left);
+		int inner_diff = y->height - rank(left ? y->left : y->right);
+		if (outer_diff == 2 && inner_diff == 2) {
+			--y->height;
+			return r;
+		}
+		if (outer_diff == 1) {
+			++y->height;
+			AVL_STATS(count(counters().rolls[operation()][
+					left ? AVLStats::RR : AVLStats::LL]));
+			y = left ? RR_roll(r) : LL_roll(r);
+			if (is_leaf(r))
+				--r->height;
+			return y;
+		}
+		Node* w = left ? y->left : y->right;
+		w->height += 2;
+		--y->height;
+		--r->height;
+		AVL_STATS(count(counters().rolls[operation()][
+				left ? AVLStats::RL : AVLStats::LR]));
+		return left ? RL_roll(r) : LR_roll(r);
 	}
 
 	/* Changes parent pointer of given node children (if any) to point to the
@@ -256,9 +1150,9 @@ class AVL {
 	static void set_parent_of_children(Node* parent) {
 		assert(parent);
 		if (parent->left)
-			parent->left->parent = parent;
+			set_parent(parent->left, parent);
 		if (parent->right)
-			parent->right->parent = parent;
+			set_parent(parent->right, parent);
 	}
 
 	/* AVL Rolls.
@@ -271,12 +1165,12 @@ class AVL {
 		r = r->left;
 		unbalanced->left = r->right;
 		r->right = unbalanced;
-		r->parent = unbalanced->parent;
-		unbalanced->parent = r;
+		set_parent(r, parent_of(unbalanced));
+		set_parent(unbalanced, r);
 		if (unbalanced->left)
-			unbalanced->left->parent = unbalanced;
-		unbalanced->height = height(unbalanced);
-		r->height = height(r);
+			set_parent(unbalanced->left, unbalanced);
+		update(unbalanced);
+		update(r);
 		return r;
 	}
 
@@ -285,12 +1179,12 @@ class AVL {
 		r = r->right;
 		unbalanced->right = r->left;
 		r->left = unbalanced;
-		r->parent = unbalanced->parent;
-		unbalanced->parent = r;
+		set_parent(r, parent_of(unbalanced));
+		set_parent(unbalanced, r);
 		if (unbalanced->right)
-			unbalanced->right->parent = unbalanced;
-		unbalanced->height = height(unbalanced);
-		r->height = height(r);
+			set_parent(unbalanced->right, unbalanced);
+		update(unbalanced);
+		update(r);
 		return r;
 	}
 
@@ -313,87 +1207,564 @@ class AVL {
 	 * @Memory complexity: O(log(n))
 	 */
 	static Node* find_r(const Key& k, Node* r) {
+		return find_r(k, r, aux::branchless_search<Key>());
+	}
+
+	static Node* find_r(const Key& k, Node* r, std::false_type) {
 		if (!r)
 			return NULL;
+		AVL_STATS(count(counters().visited[operation()]));
 		if (equal(k, r->key)) {
 			return r;
-		} else if (k < r->key) {
-			return find_r(k, r->left);
+		} else if (less(k, r->key)) {
+			return find_r(k, r->left, std::false_type());
 		} else {
-			return find_r(k, r->right);
+			return find_r(k, r->right, std::false_type());
+		}
+	}
+
+	/* Search kernel for aux::branchless_search keys. Descends down to a leaf
+	 * with one comparison per level, which selects the child (conditional
+	 * moves, rather than mispredicted branches), and remembers the last
+	 * node with key not less than k. Equality is checked once, at the end.
+	 */
+	static Node* find_r(const Key& k, Node* r, std::true_type) {
+		Node* candidate = NULL;
+		while (r) {
+			AVL_STATS(count(counters().visited[operation()]));
+			bool right = less(r->key, k);
+			Node* next[2] = { r->left, r->right };
+			Node* keep[2] = { r, candidate };
+			candidate = keep[right];
+			r = next[right];
+		}
+		return candidate && !less(k, candidate->key) ? candidate : NULL;
+	}
+
+	/* Searches subtree r for key k, and records the way down to the leaf
+	 * slot, where k would be linked: bit i of steps is set if step i goes
+	 * right. Insertion follows the steps (see insert_at_r), so keys are
+	 * compared by this search only.
+	 *
+	 * @Return: whether k is present.
+	 * @Time complexity: O(log(n))
+	 */
+	static bool find_slot(const Key& k, Node* r, unsigned long long& steps) {
+		return find_slot(k, r, steps, aux::branchless_search<Key>());
+	}
+
+	static bool find_slot(const Key& k, Node* r, unsigned long long& steps,
+			std::false_type) {
+		steps = 0;
+		for (int depth = 0; r; ++depth) {
+			AVL_STATS(count(counters().visited[operation()]));
+			if (less(k, r->key)) {
+				r = r->left;
+			} else if (less(r->key, k)) {
+				steps |= 1ULL << depth;
+				r = r->right;
+			} else {
+				return true;
+			}
 		}
+		return false;
+	}
+
+	/* Same as the find_r kernel: one comparison per level, and the step is
+	 * recorded without a branch. If k is absent, steps go right exactly at
+	 * nodes with keys less than k.
+	 */
+	static bool find_slot(const Key& k, Node* r, unsigned long long& steps,
+			std::true_type) {
+		Node* candidate = NULL;
+		steps = 0;
+		for (int depth = 0; r; ++depth) {
+			AVL_STATS(count(counters().visited[operation()]));
+			bool right = less(r->key, k);
+			Node* next[2] = { r->left, r->right };
+			Node* keep[2] = { r, candidate };
+			candidate = keep[right];
+			steps |= (unsigned long long) right << depth;
+			r = next[right];
+		}
+		return candidate && !less(k, candidate->key);
+	}
+
+	/* Searches subtree r for the first (in-order) node with key not less
+	 * than k, or greater than k if strict.
+	 *
+	 * @Return: NULL if there is no such node, pointer to node otherwise.
+	 * @Time complexity: O(log(n))
+	 */
+	static Node* bound(const Key& k, Node* r, bool strict) {
+		ancestors path;
+		return bound(k, r, strict, path);
+	}
+
+	/* Same as above, and collects ancestors of the found node to path,
+	 * for iterator at it.
+	 */
+	static Node* bound(const Key& k, Node* r, bool strict, ancestors& path) {
+		Node* candidate = NULL;
+		int candidate_path = path.size();
+		while (r) {
+			AVL_STATS(count(counters().visited[operation()]));
+			if (strict ? !less(k, r->key) : less(r->key, k)) {
+				r = r->right;
+			} else {
+				candidate = r;
+				candidate_path = path.size();
+				path.push(r);
+				r = r->left;
+			}
+		}
+		path.truncate(candidate_path);
+		return candidate;
+	}
+
+	/* Same as find_r(), but iterative, and collects ancestors of the found
+	 * node to path, for iterator at it.
+	 */
+	static Node* find_path(const Key& k, Node* r, ancestors& path) {
+		while (r) {
+			AVL_STATS(count(counters().visited[operation()]));
+			if (equal(k, r->key)) {
+				return r;
+			} else if (less(k, r->key)) {
+				path.push(r);
+				r = r->left;
+			} else {
+				r = r->right;
+			}
+		}
+		return NULL;
+	}
+
+	/* Recursive insertion to tree, where tree is rebalanced after insertion.
+	 * This function assumes, that tree doesn't contain an item with given key.
+	 *
+	 * @Return: pointer to updated (after rebalancing) root node
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* insert_r(const Key& k, const Value& v, Node* r) {
+		return insert_r(new Node(k, v), r);
+	}
+
+	/* Same as above, but links an existing node n, which doesn't belong
+	 * to any tree.
+	 */
+	static Node* insert_r(Node* n, Node* r) {
+		if (!r) {
+			n->left = n->right = NULL;
+			set_parent(n, NULL);
+			n->height = 0;
+			update(n);
+			return n;
+		}
+		AVL_STATS(count(counters().visited[operation()]));
+		if (less(n->key, r->key)) {
+			r->left = insert_r(n, r->left);
+			set_parent(r->left, r);
+		} else {
+			r->right = insert_r(n, r->right);
+			set_parent(r->right, r);
+		}
+		update(r);
+		return check_and_roll(r);
+	}
+
+	/* Same as insert_r(n, r), but n is linked at the end of given steps
+	 * (see find_slot), without comparing keys.
+	 */
+	static Node* insert_at_r(Node* n, Node* r, unsigned long long steps) {
+		if (!r)
+			return insert_r(n, r);
+		AVL_STATS(count(counters().visited[operation()]));
+		Node** children[2] = { &r->left, &r->right };
+		Node*& child = *children[steps & 1];
+		child = insert_at_r(n, child, steps >> 1);
+		set_parent(child, r);
+		update(r);
+		return check_and_roll(r);
+	}
+
+	/* Recursively removes nodes from tree and rebalances it.
+	 * Root node of the tree may change due to deletion.
+	 * Assumes that tree does contain item with key k.
+	 *
+	 * @Return: updated root of the tree after removing node with key k.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* remove_r(const Key& k, Node *r) {
+		Node* removed = NULL;
+		r = unlink_r(k, r, removed);
+		free_node(removed);
+		return r;
+	}
+
+	/* Recursively unlinks node with key k from tree and rebalances it.
+	 * Unlinked node isn't freed, it's returned through unlinked (or NULL,
+	 * if there's no such key). If node with key k has 2 children, its item
+	 * is swapped with the next one, and the node of the next item is unlinked
+	 * instead, so the unlinked node always holds key k.
+	 *
+	 * @Return: updated root of the tree after unlinking node with key k.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* unlink_r(const Key& k, Node *r, Node*& unlinked) {
+		if (!r)
+			return r;
+		AVL_STATS(count(counters().visited[operation()]));
+		if (less(k, r->key)) {
+			r->left = unlink_r(k, r->left, unlinked);
+		} else if (less(r->key, k)) {
+			r->right = unlink_r(k, r->right, unlinked);
+		} else {
+			r = unlink_here(r, unlinked);
+		}
+		if (!r)
+			return r;
+		update(r);
+		return check_and_roll(r);
+	}
+
+	/* Same as unlink_r, but unlinks the node at the end of given steps from
+	 * r (see steps_to), rather than searching it by key.
+	 *
+	 * @Return: updated root of the tree after unlinking the node.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* unlink_at_r(Node* r, unsigned long long steps, int depth,
+			Node*& unlinked) {
+		assert(r);
+		AVL_STATS(count(counters().visited[operation()]));
+		if (!depth) {
+			r = unlink_here(r, unlinked);
+		} else if (steps & 1) {
+			r->right = unlink_at_r(r->right, steps >> 1, depth - 1, unlinked);
+		} else {
+			r->left = unlink_at_r(r->left, steps >> 1, depth - 1, unlinked);
+		}
+		if (!r)
+			return r;
+		update(r);
+		return check_and_roll(r);
+	}
+
+	/* Unlinks node r from its subtree. If r has 2 children, its item is
+	 * swapped with the next one, and the node of the next item is unlinked
+	 * instead, so the unlinked node always holds item of r.
+	 * Caller links the returned subtree in place of r, and rebalances it.
+	 *
+	 * @Return: subtree, which replaces r.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* unlink_here(Node* r, Node*& unlinked) {
+		if (is_leaf(r)) { // no children
+			unlinked = r;
+			return NULL;
+		}
+		if (!r->right || !r->left) { // 1 child
+			Node *child = r->right ? r->right : r->left;
+			set_parent(child, parent_of(r));
+			unlinked = r;
+			return child;
+		}
+		// 2 children
+		Node* next;
+		r->right = unlink_leftmost_r(r->right, next);
+		if (r->right)
+			set_parent(r->right, r);
+		aux::swap(r->value, next->value);
+		aux::swap(r->value_pooled, next->value_pooled);
+		aux::swap(r->key, next->key);
+		unlinked = next;
+		return r;
+	}
+
+	/* Recursively unlinks the leftmost node of subtree r, and rebalances it.
+	 * Unlinked node isn't freed, it's returned through min.
+	 * Assumes r isn't null.
+	 *
+	 * @Return: updated root of the subtree, after unlinking.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* unlink_leftmost_r(Node* r, Node*& min) {
+		assert(r);
+		AVL_STATS(count(counters().visited[operation()]));
+		if (!r->left) {
+			min = r;
+			Node *child = r->right;
+			if (child)
+				set_parent(child, parent_of(r));
+			min->right = NULL;
+			set_parent(min, NULL);
+			return child;
+		}
+		r->left = unlink_leftmost_r(r->left, min);
+		if (r->left)
+			set_parent(r->left, r);
+		update(r);
+		return check_and_roll(r);
+	}
+
+	/* Given root node of (sub)tree returns number of nodes of that tree.
+	 *
+	 * @Return: number of nodes in the subtree of r
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static int size_r(Node *r) {
+		if (!r)
+			return 0;
+		return 1 + size_r(r->left) + size_r(r->right);
+	}
+
+	/* Aggregate of the whole subtree r. Subtree may be empty.
+	 * @Time complexity: O(1)
+	 */
+	static aggregate_type subtree_aggregate(Node* r) {
+		return r ? r->aggregate : Augment::identity();
+	}
+
+	/* Aggregate of item at node r alone. Assumes r isn't null.
+	 * @Time complexity: O(1)
+	 */
+	static aggregate_type item_aggregate(Node* r) {
+		return Augment::lift(r->key, *(r->value));
+	}
+
+	/* Recursively aggregates all items in subtree r with keys not less than lo.
+	 *
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static aggregate_type aggregate_from_r(const Key& lo, Node* r) {
+		if (!r)
+			return Augment::identity();
+		if (r->key < lo)
+			return aggregate_from_r(lo, r->right);
+		return Augment::combine(aggregate_from_r(lo, r->left),
+				Augment::combine(item_aggregate(r), subtree_aggregate(r->right)));
+	}
+
+	/* Recursively aggregates all items in subtree r with keys less than hi.
+	 *
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static aggregate_type aggregate_below_r(const Key& hi, Node* r) {
+		if (!r)
+			return Augment::identity();
+		if (!(r->key < hi))
+			return aggregate_below_r(hi, r->left);
+		return Augment::combine(
+				Augment::combine(subtree_aggregate(r->left), item_aggregate(r)),
+				aggregate_below_r(hi, r->right));
+	}
+
+	/* Recursively aggregates all items in subtree r with keys in [lo, hi).
+	 * Descends until the range splits, then only the two range bounds are
+	 * followed - subtrees between them contribute their cached aggregates.
+	 *
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static aggregate_type aggregate_r(const Key& lo, const Key& hi, Node* r) {
+		if (!r)
+			return Augment::identity();
+		if (r->key < lo)
+			return aggregate_r(lo, hi, r->right);
+		if (!(r->key < hi))
+			return aggregate_r(lo, hi, r->left);
+		return Augment::combine(aggregate_from_r(lo, r->left),
+				Augment::combine(item_aggregate(r), aggregate_below_r(hi, r->right)));
+	}
+
+	/* Joins trees l and r with detached node m between them, i.e. keys of l
+	 * aren't greater than key of m, and keys of r aren't less than it.
+	 * Descends along the spine of the higher tree down to subtree of about
+	 * the same height as the lower tree, and links them by m there. Tree is
+	 * rebalanced by rolls on the way up.
+	 *
+	 * @Return: root of the joined tree. Its parent pointer isn't set.
+	 * @Time complexity: O(|height(l) - height(r)| + 1)
+	 * @Memory complexity: O(|height(l) - height(r)| + 1)
+	 */
+	static Node* join(Node* l, Node* m, Node* r) {
+		if (rank(l) > rank(r) + 1) {
+			l->right = join(l->right, m, r);
+			set_parent(l->right, l);
+			update(l);
+			return check_and_roll(l);
+		}
+		if (rank(r) > rank(l) + 1) {
+			r->left = join(l, m, r->left);
+			set_parent(r->left, r);
+			update(r);
+			return check_and_roll(r);
+		}
+		m->left = l;
+		m->right = r;
+		set_parent_of_children(m);
+		m->height = aux::max(rank(l), rank(r)) + 1;
+		update(m);
+		return m;
+	}
+
+	/* Joins trees l and r, where keys of l aren't greater than keys of r.
+	 * Leftmost node of r is unlinked, and used to join the trees.
+	 *
+	 * @Return: root of the joined tree, with no parent.
+	 * @Time complexity: O(log(n)), where n is size of the joined tree.
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* join(Node* l, Node* r) {
+		if (!r)
+			return l;
+		if (!l)
+			return r;
+		Node* m;
+		r = unlink_leftmost_r(r, m);
+		Node* joined = join(l, m, r);
+		set_parent(joined, NULL);
+		return joined;
+	}
+
+	/* Recursively splits tree r into two trees: less, with keys less than k
+	 * (or not greater than k if inclusive), and rest, with all other keys.
+	 * Tree r doesn't exist after split, its nodes are moved to the new trees.
+	 * Order of items with equal keys is preserved.
+	 *
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	static void split_r(Node* r, const Key& k, bool inclusive, Node*& less,
+			Node*& rest) {
+		if (!r) {
+			less = rest = NULL;
+			return;
+		}
+		Node *l = r->left, *right = r->right;
+		r->left = r->right = NULL;
+		if (inclusive ? !(k < r->key) : r->key < k) {
+			Node* right_less;
+			split_r(right, k, inclusive, right_less, rest);
+			less = join(l, r, right_less);
+		} else {
+			Node* left_rest;
+			split_r(l, k, inclusive, less, left_rest);
+			rest = join(left_rest, r, right);
+		}
+		if (less)
+			set_parent(less, NULL);
+		if (rest)
+			set_parent(rest, NULL);
+	}
+
+	/* Cuts all items with keys in [lo, hi) out of the tree.
+	 * Tree is split at both bounds, and the outer parts are joined back.
+	 *
+	 * @Return: root of the tree of cut items, with no parent.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	Node* cut_range(const Key& lo, const Key& hi) {
+		if (!(lo < hi))
+			return NULL;
+		Node *less, *rest, *middle, *greater;
+		split_r(root, lo, false, less, rest);
+		split_r(rest, hi, false, middle, greater);
+		root = join(less, greater);
+		return middle;
+	}
+
+#ifdef AVL_ENABLE_STATS
+	/* Adds nodes of subtree r, which is at depth d, to histogram.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	static void depth_histogram_r(Node* r, int d, std::vector<int>& histogram) {
+		if (!r)
+			return;
+		++histogram[d];
+		depth_histogram_r(r->left, d + 1, histogram);
+		depth_histogram_r(r->right, d + 1, histogram);
 	}
+#endif
 
-	/* Recursive insertion to tree, where tree is rebalanced after insertion.
-	 * This function assumes, that tree doesn't contain an item with given key.
-	 *
-	 * @Return: pointer to updated (after rebalancing) root node
-	 * @Time complexity: O(log(n))
+	/* Appends nodes of subtree r to order, in-order.
+	 * @Time complexity: O(n)
 	 * @Memory complexity: O(log(n))
 	 */
-	static Node* insert_r(const Key& k, const Value& v, Node* r) {
+	static void inorder_r(Node* r, std::vector<Node*>& order) {
 		if (!r)
-			return new Node(k, v);
-		if (k < r->key) {
-			r->left = insert_r(k, v, r->left);
-			r->left->parent = r;
-		} else {
-			r->right = insert_r(k, v, r->right);
-			r->right->parent = r;
-		}
-		r->height = height(r);
-		return check_and_roll(r);
+			return;
+		inorder_r(r->left, order);
+		order.push_back(r);
+		inorder_r(r->right, order);
 	}
 
-	/* Recursively removes nodes from tree and rebalances it.
-	 * Root node of the tree may change due to deletion.
-	 * Assumes that tree does contain item with key k.
+	/* Appends nodes of top levels of subtree r to order, in van Emde Boas
+	 * order: top half of the levels recursively, and then each subtree
+	 * below it recursively. So any root-to-leaf path crosses only
+	 * O(log(n)/log(B)) blocks of B nodes, whatever B is.
 	 *
-	 * @Return: updated root of the tree after removing node with key k.
-	 * @Time complexity: O(log(n))
-	 * @Memory complexity: O(log(n))
+	 * @Time complexity: O(n*log(log(n)))
+	 * @Memory complexity: O(n)
 	 */
-	static Node* remove_r(const Key& k, Node *r) {
+	static void veb_r(Node* r, int levels, std::vector<Node*>& order) {
 		if (!r)
-			return r;
-		if (k < r->key) {
-			r->left = remove_r(k, r->left);
-		} else if (r->key < k) {
-			r->right = remove_r(k, r->right);
-		} else {
-			if (is_leaf(r)) { // no children
-				set_child_of_parent(r, NULL);
-				delete r;
-				r = NULL;
-			} else if (!r->right || !r->left) { // 1 child
-				Node *child = r->right ? r->right : r->left;
-				child->parent = r->parent;
-				set_child_of_parent(r, child);
-				delete r;
-				r = child;
-			} else { // 2 children
-				Node* next = next_inorder(r);
-				aux::swap(r->value, next->value);
-				aux::swap(r->key, next->key);
-				remove_r(k, next);
-			}
+			return;
+		if (levels == 1) {
+			order.push_back(r);
+			return;
 		}
+		int top = levels / 2;
+		veb_r(r, top, order);
+		std::vector<Node*> below;
+		nodes_at_depth_r(r, top, below);
+		for (size_t i = 0; i < below.size(); ++i) {
+			veb_r(below[i], levels - top, order);
+		}
+	}
+
+	/* Appends nodes at depth d of subtree r to nodes, left to right.
+	 * @Time complexity: O(2^d)
+	 */
+	static void nodes_at_depth_r(Node* r, int d, std::vector<Node*>& nodes) {
 		if (!r)
-			return r;
-		r->height = height(r);
-		return check_and_roll(r);
+			return;
+		if (!d) {
+			nodes.push_back(r);
+			return;
+		}
+		nodes_at_depth_r(r->left, d - 1, nodes);
+		nodes_at_depth_r(r->right, d - 1, nodes);
 	}
 
-	/* Given root node of (sub)tree returns number of nodes of that tree.
-	 *
-	 * @Return: number of nodes in the subtree of r
-	 * @Time complexity: O(log(n))
+	/* Adds memory of nodes of subtree r to usage.
+	 * @Time complexity: O(n)
 	 * @Memory complexity: O(log(n))
 	 */
-	static int size_r(Node *r) {
+	static void memory_usage_r(Node* r, AVLMemoryUsage& usage) {
 		if (!r)
-			return 0;
-		return 1 + size_r(r->left) + size_r(r->right);
+			return;
+		usage.nodes += sizeof(Node);
+		usage.values += sizeof(Value);
+		usage.slack += r->pooled ? aux::slabs::slack(r, sizeof(Node))
+				: aux::heap_slack(r, sizeof(Node));
+		usage.slack += r->value_pooled
+				? aux::slabs::slack(r->value, sizeof(Value))
+				: aux::heap_slack(r->value, sizeof(Value));
+		memory_usage_r(r->left, usage);
+		memory_usage_r(r->right, usage);
 	}
 
 	/* Frees all nodes recursively
@@ -406,7 +1777,7 @@ class AVL {
 			return;
 		destroy_r(r->left);
 		destroy_r(r->right);
-		delete r;
+		free_node(r);
 	}
 
 	/* Gets two sorted arrays, of keys and pointers to values
@@ -427,24 +1798,192 @@ class AVL {
 		tmp_root->left = tree_from_array(k_arr, v_arr, from, mid - 1);
 		tmp_root->right = tree_from_array(k_arr, v_arr, mid + 1, to);
 		set_parent_of_children(tmp_root);
-		tmp_root->height = height(tmp_root);
+		update_built(tmp_root);
+		return tmp_root;
+	}
+
+	/* Builds a tree of count items, taken one by one from source in
+	 * ascending order of keys. Source must define Node* next(), which
+	 * returns a new node of the next item, or NULL if there are no more
+	 * items (e.g. on read error).
+	 * Tree has the same shape as tree_from_array builds, but it's built
+	 * in-order: left subtree, node, right subtree, so only O(log(p)) items
+	 * are held at a time.
+	 * If source fails, ok is set to false, and partially built tree is
+	 * returned.
+	 *
+	 * @Return: root of the new tree.
+	 * @Time complexity: O(p), where p is count.
+	 * @Memory complexity: O(log(p))
+	 */
+	template<typename Source>
+	static Node* tree_from_source(Source& source, int count, bool& ok) {
+		if (count <= 0 || !ok)
+			return NULL;
+		int left_count = (count - 1) / 2;
+		Node *left = tree_from_source(source, left_count, ok);
+		if (!ok)
+			return left;
+		Node *tmp_root;
+		try {
+			tmp_root = source.next();
+		} catch (...) {
+			destroy_r(left);
+			throw;
+		}
+		if (!tmp_root) {
+			ok = false;
+			return left;
+		}
+		tmp_root->left = left;
+		tmp_root->right = tree_from_source(source, count - 1 - left_count, ok);
+		set_parent_of_children(tmp_root);
+		update_built(tmp_root);
 		return tmp_root;
 	}
 
+	/* Source of nodes for tree_from_source, which reads items from stream
+	 * by given codecs. */
+	template<typename KeyCodec, typename ValueCodec>
+	struct StreamSource {
+		std::istream& is;
+		StreamSource(std::istream& is) : is(is) {}
+		Node* next() {
+			Key k = KeyCodec::read(is);
+			Value v = ValueCodec::read(is);
+			return is ? new Node(k, v) : NULL;
+		}
+	};
+
+	/* Same as tree_from_array(), from array of keys and pointers to values,
+	 * which aren't freed. Subtrees are built by up to given number of
+	 * threads. If building fails, nodes built so far are freed.
+	 *
+	 * @Return: root of the new tree.
+	 * @Time complexity: O(p/t + log(p)), where p is size of array, i.e.
+	 *     initial (to-from), and t is number of threads.
+	 * @Memory complexity: O(log(p))
+	 */
+	static Node* tree_from_items(std::pair<Key, const Value*>* items, int from,
+			int to, unsigned threads) {
+		if (from > to)
+			return NULL;
+		int mid = from + (to - from) / 2;
+		Node *left = NULL, *right = NULL;
+		try {
+			if (threads > 1 && to - from > aux::PARALLEL_GRAIN) {
+				aux::fork_join([&]() {
+					left = tree_from_items(items, from, mid - 1, threads / 2);
+				}, [&]() {
+					right = tree_from_items(items, mid + 1, to,
+							threads - threads / 2);
+				});
+			} else {
+				left = tree_from_items(items, from, mid - 1, 1);
+				right = tree_from_items(items, mid + 1, to, 1);
+			}
+			Node *tmp_root = new Node(items[mid].first, *(items[mid].second));
+			tmp_root->left = left;
+			tmp_root->right = right;
+			set_parent_of_children(tmp_root);
+			update_built(tmp_root);
+			return tmp_root;
+		} catch (...) {
+			destroy_r(left);
+			destroy_r(right);
+			throw;
+		}
+	}
+
+	/* Copies subtree r node for node: same shape, heights (or ranks) and
+	 * aggregates. Subtrees of heights above aux::PARALLEL_HEIGHT are copied
+	 * by up to given number of threads. If copying fails, nodes copied so
+	 * far are freed.
+	 *
+	 * @Return: root of the copy, with no parent.
+	 * @Time complexity: O(n/t + log(n)), where n is size of subtree r,
+	 *     and t is number of threads.
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* copy_r(Node* r, unsigned threads) {
+		if (!r)
+			return NULL;
+		Node *left = NULL, *right = NULL;
+		try {
+			if (threads > 1 && r->height > aux::PARALLEL_HEIGHT) {
+				aux::fork_join([&]() {
+					left = copy_r(r->left, threads / 2);
+				}, [&]() {
+					right = copy_r(r->right, threads - threads / 2);
+				});
+			} else {
+				left = copy_r(r->left, 1);
+				right = copy_r(r->right, 1);
+			}
+			Node *copy = new Node(r->key, *(r->value));
+			copy->left = left;
+			copy->right = right;
+			set_parent_of_children(copy);
+			copy->height = r->height;
+			update(copy);
+			return copy;
+		} catch (...) {
+			destroy_r(left);
+			destroy_r(right);
+			throw;
+		}
+	}
+
+	/* Keys order of items of tree_from_items(). */
+	static bool item_less(const std::pair<Key, const Value*>& a,
+			const std::pair<Key, const Value*>& b) {
+		return a.first < b.first;
+	}
+	static bool item_equal(const std::pair<Key, const Value*>& a,
+			const std::pair<Key, const Value*>& b) {
+		return !(a.first < b.first || b.first < a.first);
+	}
+
+	/* Source of nodes for tree_from_source, which copies items from range
+	 * of iterators to pairs (e.g. std::pair<Key, Value>). */
+	template<typename InputIt>
+	struct RangeSource {
+		InputIt current, last;
+		RangeSource(InputIt first, InputIt last) : current(first), last(last) {}
+		Node* next() {
+			if (current == last)
+				return NULL;
+			Node* n = new Node(current->first, current->second);
+			++current;
+			return n;
+		}
+	};
+
+	/* Snapshot format identification, see save(). */
+	enum {
+		SNAPSHOT_MAGIC = 0x53564141, // "AAVS"
+		SNAPSHOT_VERSION = 1
+	};
+
 	/* Helper function for trees merging.
 	 * Gets 2 trees (this and t) and fills two given and !allocated! arrays
 	 * with keys and values of both trees in ascending order of keys.
 	 *
-	 * After merging, output arrays keys and values will only contain unique
-	 * keys. If there are same keys, value from the left tree will be taken.
-	 *
+	 * If unique, output arrays keys and values will only contain unique
+	 * keys (assuming each tree has unique keys). If there are same keys, value
+	 * from the left tree will be taken. Otherwise all items are kept, and
+	 * items from the left tree precede items with same key from the right.
+	 * Items, for which skip(key) is true, are left out. Keys are passed to
+	 * skip in ascending order.
 	 *
-	 * @Return: number of unique keys in merged array.
+	 * @Return: number of items in merged array.
 	 * @Time complexity: O(m+n), where m and n are numbers of nodes in current
 	 *     and joining tree.
 	 * @Memory complexity: O(m+n)
 	 * */
-	int trees_to_arrays(const AVL<Key, Value>& t, Key* keys, Value** values) {
+	template<typename Skip>
+	int trees_to_arrays(const AVL& t, Key* keys, Value** values, bool unique,
+			Skip& skip) {
 		inorderIterator l = begin(), r = t.begin(), l_end = end(), r_end = t.end();
 		int i = 0;
 		while (l != l_end || r != r_end) {
@@ -453,6 +1992,8 @@ class AVL {
 				if (r.key() < l.key()) {
 					current = r++;
 				} else {
+					if (unique && !(l.key() < r.key()))
+						++r;
 					current = l++;
 				}
 			} else
@@ -461,6 +2002,8 @@ class AVL {
 			} else { // r != r_end
 				current = r++;
 			}
+			if (skip(current.key()))
+				continue;
 			keys[i] = current.key();
 			values[i] = new Value(current.value());
 			++i;
@@ -469,6 +2012,11 @@ class AVL {
 	}
 
 public:
+	/* In-order iterator type, as returned by begin(), end() and find(). */
+	typedef inorderIterator iterator;
+	/* Node handle type, as returned by extract(). */
+	typedef nodeHandle node_handle;
+
 	/* Default C'tor. Creates empty tree.
 	 * @Time complexity: O(1)
 	 */
@@ -481,29 +2029,48 @@ public:
 		root = new Node(k, v);
 	}
 
-	/* Copy C'tor.
-	 * Resulting tree will not be exact copy of original tree.
-	 * It will contain all nodes, but tree structure may differ.
+	/* Copy C'tor. Copies tree t node for node, big trees - by all hardware
+	 * threads.
 	 *
 	 * @Time complexity: O(m), where m is number of nodes in tree t.
-	 * @Memory complexity: O(m)
+	 * @Memory complexity: O(log(m))
 	 * */
-	AVL(const AVL& t) :	root(NULL) {
-		merge(t);
+	AVL(const AVL& t) :
+			root(copy_r(t.root, std::thread::hardware_concurrency())) {}
+
+	/* Move C'tor. Takes all nodes of t, which is left empty.
+	 * @Time complexity: O(1)
+	 */
+	AVL(AVL&& t) : root(t.root) {
+		t.root = NULL;
 	}
 
-	/* Assignment operator.
-	 * Resulting tree will not be exact copy of original tree.
-	 * It will contain all nodes, but tree structure may differ.
+	/* Assignment operator. Copies tree t as copy C'tor does.
 	 *
 	 * @Return: *this
 	 * @Time complexity: O(n + m), where m is number of nodes in tree t.
-	 * @Memory complexity: O(n + m)
+	 * @Memory complexity: O(log(n + m))
 	 */
 	AVL& operator=(const AVL& t) {
+		if (this != &t) {
+			Node* copy = copy_r(t.root, std::thread::hardware_concurrency());
+			clear();
+			root = copy;
+		}
+		return *this;
+	}
+
+	/* Move assignment operator. Takes all nodes of t, which is left empty.
+	 *
+	 * @Return: *this
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	AVL& operator=(AVL&& t) {
 		if (this != &t) {
 			clear();
-			merge(t);
+			root = t.root;
+			t.root = NULL;
 		}
 		return *this;
 	}
@@ -515,7 +2082,13 @@ public:
 	 * @Time complexity: O(log(n))
 	 */
 	inorderIterator begin() const {
-		return inorderIterator(leftmost(root));
+		ancestors path;
+		Node* first = root;
+		while (first && first->left) {
+			path.push(first);
+			first = first->left;
+		}
+		return inorderIterator(first, path);
 	}
 
 	/* Returns an iterator to the element following the last (i.e largest)
@@ -547,23 +2120,106 @@ public:
 	 * @Memory complexity: O(log(n))
 	 */
 	inorderIterator find(const Key& k) const {
-		return inorderIterator(find_r(k, root));
+		AVL_STATS(statsScope scope(AVLStats::FIND));
+		ancestors path;
+		Node* found = ancestors::needed ? find_path(k, root, path)
+				: find_r(k, root);
+		return inorderIterator(found, path);
+	}
+
+	/* Searches the tree for the first (in-order) item with key not less than k.
+	 *
+	 * @Return: in-order iterator to that item, or iterator to end() if all
+	 *     keys are less than k.
+	 * @Time complexity: O(log(n))
+	 */
+	inorderIterator lower_bound(const Key& k) const {
+		AVL_STATS(statsScope scope(AVLStats::FIND));
+		ancestors path;
+		Node* found = bound(k, root, false, path);
+		return inorderIterator(found, path);
+	}
+
+	/* Searches the tree for the first (in-order) item with key greater than k.
+	 *
+	 * @Return: in-order iterator to that item, or iterator to end() if no
+	 *     key is greater than k.
+	 * @Time complexity: O(log(n))
+	 */
+	inorderIterator upper_bound(const Key& k) const {
+		AVL_STATS(statsScope scope(AVLStats::FIND));
+		ancestors path;
+		Node* found = bound(k, root, true, path);
+		return inorderIterator(found, path);
 	}
 
 	/* Inserts an item with given key k and value v.
 	 * If item is already present - tree stays unchanged, and false returned.
 	 *
+	 * Keys are compared by a single search (branch-free for
+	 * aux::branchless_search keys), which records the way to the new node.
+	 *
 	 * @Return: false if item with key is in dictionary.
-	 * @Time complexity: O(log(n)), as find and insert_r both are O(log(n))
+	 * @Time complexity: O(log(n))
 	 * @Memory complexity: O(log(n))
 	 */
 	bool insert(const Key& k, const Value& v) {
-		if (find(k) != end())
+		AVL_STATS(statsScope scope(AVLStats::INSERT));
+		unsigned long long steps;
+		if (find_slot(k, root, steps))
+			return false;
+		root = insert_at_r(new Node(k, v), root, steps);
+		return true;
+	}
+
+	/* Links node of handle h back into the tree. Handle may come from
+	 * another tree of the same type. Nothing is allocated or copied.
+	 * If handle is empty, or key is already present - tree stays unchanged,
+	 * handle keeps its node, and false returned.
+	 *
+	 * @Return: true if node was inserted, and h is empty now.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	bool insert(nodeHandle&& h) {
+		AVL_STATS(statsScope scope(AVLStats::INSERT));
+		unsigned long long steps;
+		if (h.empty() || find_slot(h.key(), root, steps))
 			return false;
-		root = insert_r(k, v, root);
+		root = insert_at_r(release(h), root, steps);
 		return true;
 	}
 
+	/* Unlinks an element with key k from the tree, without freeing it.
+	 * If element with Key k isn't present - returns empty handle.
+	 *
+	 * @Return: handle, that owns the unlinked element.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	nodeHandle extract(const Key& k) {
+		AVL_STATS(statsScope scope(AVLStats::REMOVE));
+		Node* unlinked = NULL;
+		root = unlink_r(k, root, unlinked);
+		return nodeHandle(unlinked);
+	}
+
+	/* Unlinks an element at it from the tree, without freeing it.
+	 * !IMPORTANT! iterator must be valid (e.g. not end()).
+	 *
+	 * @Return: handle, that owns the unlinked element.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	nodeHandle extract(const inorderIterator& it) {
+		AVL_STATS(statsScope scope(AVLStats::REMOVE));
+		int depth;
+		unsigned long long steps = steps_to(it.node, root, depth, it.path);
+		Node* unlinked = NULL;
+		root = unlink_at_r(root, steps, depth, unlinked);
+		return nodeHandle(unlinked);
+	}
+
 	/* Removes an element with key k from the tree.
 	 * If element with Key k isn't present - does nothing.
 	 *
@@ -571,11 +2227,40 @@ public:
 	 * @Memory complexity: O(log(n))
 	 */
 	void remove(const Key& k) {
-		if (find(k) == end())
+		AVL_STATS(statsScope scope(AVLStats::REMOVE));
+		if (!find_r(k, root))
 			return;
 		root = remove_r(k, root);
 	}
 
+	/* Removes all elements with keys in [lo, hi) from the tree.
+	 * Items are cut out by splitting the tree, so there is no per-item
+	 * rebalancing.
+	 *
+	 * @Return: number of removed elements.
+	 * @Time complexity: O(log(n) + k), where k is number of removed elements.
+	 * @Memory complexity: O(log(n))
+	 */
+	int erase_range(const Key& lo, const Key& hi) {
+		Node* removed = cut_range(lo, hi);
+		int count = size_r(removed);
+		destroy_r(removed);
+		return count;
+	}
+
+	/* Moves all elements with keys in [lo, hi) to a new tree. Nodes aren't
+	 * copied, they are relinked into the new tree.
+	 *
+	 * @Return: tree of removed elements.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	AVL extract_range(const Key& lo, const Key& hi) {
+		AVL extracted;
+		extracted.root = cut_range(lo, hi);
+		return extracted;
+	}
+
 	/* Counts number of nodes in tree.
 	 *
 	 * @Return: number of nodes in tree
@@ -586,6 +2271,85 @@ public:
 		return size_r(root);
 	}
 
+	/* Aggregates (as defined by Augment policy) all items with keys in
+	 * half-open range [lo, hi). Available for augmented trees only.
+	 *
+	 * @Return: aggregate of items in range, or Augment::identity() if there
+	 *     are no such items.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	aggregate_type aggregate(const Key& lo, const Key& hi) const {
+		return aggregate_r(lo, hi, root);
+	}
+
+	/* Aggregates all items of the tree. Available for augmented trees only.
+	 *
+	 * @Return: aggregate of all items, or Augment::identity() if tree is empty.
+	 * @Time complexity: O(1)
+	 */
+	aggregate_type aggregate() const {
+		return subtree_aggregate(root);
+	}
+
+#ifdef AVL_ENABLE_STATS
+	/* Statistics of all trees of this type, since start of the program or
+	 * the last reset_stats(). Available if AVL_ENABLE_STATS is defined.
+	 *
+	 * @Return: copy of the counters.
+	 * @Time complexity: O(1)
+	 */
+	static AVLStats stats() {
+		statsCounters& c = counters();
+		AVLStats s;
+		for (int op = 0; op < AVLStats::OPERATIONS; ++op) {
+			s.operations[op] = c.operations[op].load(std::memory_order_relaxed);
+			for (int roll = 0; roll < AVLStats::ROLLS; ++roll) {
+				s.rolls[op][roll] = c.rolls[op][roll].load(std::memory_order_relaxed);
+			}
+			s.comparisons[op] = c.comparisons[op].load(std::memory_order_relaxed);
+			s.visited[op] = c.visited[op].load(std::memory_order_relaxed);
+		}
+		s.allocations = c.allocations.load(std::memory_order_relaxed);
+		s.frees = c.frees.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	/* Zeroes statistics of all trees of this type.
+	 * @Time complexity: O(1)
+	 */
+	static void reset_stats() {
+		statsCounters& c = counters();
+		for (int op = 0; op < AVLStats::OPERATIONS; ++op) {
+			c.operations[op].store(0, std::memory_order_relaxed);
+			for (int roll = 0; roll < AVLStats::ROLLS; ++roll) {
+				c.rolls[op][roll].store(0, std::memory_order_relaxed);
+			}
+			c.comparisons[op].store(0, std::memory_order_relaxed);
+			c.visited[op].store(0, std::memory_order_relaxed);
+		}
+		c.allocations.store(0, std::memory_order_relaxed);
+		c.frees.store(0, std::memory_order_relaxed);
+	}
+
+	/* Counts nodes at each depth of the tree (root is at depth 0).
+	 * Available if AVL_ENABLE_STATS is defined.
+	 *
+	 * @Return: histogram h, where h[d] is number of nodes at depth d.
+	 *     Empty, if tree is empty.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	std::vector<int> depth_histogram() const {
+		std::vector<int> histogram(root ? root->height + 1 : 0, 0);
+		depth_histogram_r(root, 0, histogram);
+		while (!histogram.empty() && !histogram.back()) { // rank above height
+			histogram.pop_back();
+		}
+		return histogram;
+	}
+#endif
+
 	/* Frees all nodes
 	 *
 	 * @Time complexity: O(n)
@@ -596,6 +2360,191 @@ public:
 		root = NULL;
 	}
 
+	/* Reports memory used by the tree: nodes, values, and allocator slack.
+	 * Memory owned by keys and values (e.g. characters of strings) isn't
+	 * included.
+	 *
+	 * @Return: memory usage in bytes.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	AVLMemoryUsage memory_usage() const {
+		AVLMemoryUsage usage = { 0, 0, 0 };
+		memory_usage_r(root, usage);
+		return usage;
+	}
+
+	/* Relocates all nodes to contiguous memory (slab of 64KB chunks), and
+	 * all values to another one, in given order. Contents and structure of
+	 * the tree don't change. Used to restore locality of scans or searches,
+	 * after nodes got scattered over the heap by insertions and removals.
+	 * Keys and values are moved (copied, if their move may throw). Chunk is
+	 * freed with its last node, even if it's moved to another tree (e.g. by
+	 * extract_range()).
+	 * If a copy throws, the tree is left as it was (strong guarantee).
+	 * Otherwise, all iterators, references and pointers are invalidated.
+	 *
+	 * @Time complexity: O(n), O(n*log(log(n))) for COMPACT_VEB.
+	 * @Memory complexity: O(n), old nodes are freed at the end (values are
+	 *     moved, not copied).
+	 */
+	void compact(CompactOrder order = COMPACT_INORDER) {
+		static_assert(alignof(Node) <= alignof(std::max_align_t)
+				&& alignof(Value) <= alignof(std::max_align_t),
+				"over-aligned nodes can't be compacted");
+		if (!root)
+			return;
+		std::vector<Node*> nodes;
+		if (order == COMPACT_VEB) {
+			veb_r(root, root->height + 1, nodes);
+		} else {
+			inorder_r(root, nodes);
+		}
+		size_t n = nodes.size();
+		std::vector<Node*> relocated(n);
+		aux::slabs::slab node_slab(sizeof(Node), n);
+		aux::slabs::slab value_slab(sizeof(Value), n);
+		// Old nodes aren't changed until all items are relocated, so a throw
+		// is undone by moving the relocated items back.
+		size_t built = 0;
+		try {
+			for (; built < n; ++built) {
+				relocated[built] = relocate(nodes[built], node_slab, value_slab);
+			}
+		} catch (...) {
+			node_slab.release_unused();
+			value_slab.release_unused();
+			while (built > 0) {
+				--built;
+				unrelocate(nodes[built], relocated[built]);
+			}
+			throw;
+		}
+		// Relocated nodes take child links of the old ones, and old left links
+		// keep the relocated nodes meanwhile.
+		for (size_t i = 0; i < n; ++i) {
+			Node* old = nodes[i];
+			relocated[i]->left = old->left;
+			relocated[i]->right = old->right;
+			old->left = relocated[i];
+		}
+		for (size_t i = 0; i < n; ++i) {
+			Node* r = relocated[i];
+			if (r->left)
+				r->left = r->left->left;
+			if (r->right)
+				r->right = r->right->left;
+			set_parent_of_children(r);
+		}
+		root = root->left;
+		for (size_t i = 0; i < n; ++i) {
+			free_node(nodes[i]);
+		}
+	}
+
+	/* Writes all items to stream, in a compact binary format:
+	 * header (magic, format version, number of items), followed by items in
+	 * ascending order of keys, each is a key and a value, written by given
+	 * codecs (see AVLCodec.hpp). Items are written directly from the tree,
+	 * nothing is copied.
+	 *
+	 * @Return: true if all data was written successfully.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	template<typename KeyCodec = BinaryCodec<Key>,
+			typename ValueCodec = BinaryCodec<Value> >
+	bool save(std::ostream& os) const {
+		BinaryCodec<uint32_t>::write(os, SNAPSHOT_MAGIC);
+		BinaryCodec<uint32_t>::write(os, SNAPSHOT_VERSION);
+		BinaryCodec<uint64_t>::write(os, size());
+		for (inorderIterator it = begin(); it != end() && os; ++it) {
+			KeyCodec::write(os, it.node->key);
+			ValueCodec::write(os, *(it.node->value));
+		}
+		return !os.fail();
+	}
+
+	/* Replaces contents of the tree by items, read from stream, which was
+	 * written by save() with same codecs. Balanced tree is built directly
+	 * from the stream in linear time, without insertions or temporary arrays.
+	 * If data is invalid or truncated, tree stays unchanged.
+	 * All pointers, iterators and references of the tree are invalidated.
+	 *
+	 * @Return: true if tree was loaded successfully.
+	 * @Time complexity: O(n + p), where p is number of loaded items.
+	 * @Memory complexity: O(log(p))
+	 */
+	template<typename KeyCodec = BinaryCodec<Key>,
+			typename ValueCodec = BinaryCodec<Value> >
+	bool load(std::istream& is) {
+		uint32_t magic = BinaryCodec<uint32_t>::read(is);
+		uint32_t version = BinaryCodec<uint32_t>::read(is);
+		uint64_t count = BinaryCodec<uint64_t>::read(is);
+		if (!is || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION
+				|| count > (uint64_t) std::numeric_limits<int>::max())
+			return false;
+		bool ok = true;
+		StreamSource<KeyCodec, ValueCodec> source(is);
+		Node *tmp_root = tree_from_source(source, count, ok);
+		if (!ok) {
+			destroy_r(tmp_root);
+			return false;
+		}
+		clear();
+		root = tmp_root;
+		return true;
+	}
+
+	/* Replaces contents of the tree by items of range [first, last) of pairs
+	 * (e.g. std::pair<Key, Value>), i.e. with members first and second.
+	 * Keys must be unique and sorted in ascending order.
+	 * Balanced tree is built directly, in linear time, without insertions.
+	 * All pointers, iterators and references of the tree are invalidated.
+	 *
+	 * @Time complexity: O(n + p), where p is size of the range.
+	 * @Memory complexity: O(log(p))
+	 */
+	template<typename ForwardIt>
+	void assign_sorted(ForwardIt first, ForwardIt last) {
+		bool ok = true;
+		RangeSource<ForwardIt> source(first, last);
+		Node *tmp_root = tree_from_source(source, std::distance(first, last), ok);
+		clear();
+		root = tmp_root;
+	}
+
+	/* Replaces contents of the tree by items of range [first, last) of pairs
+	 * (e.g. std::pair<Key, Value>), i.e. with members first and second,
+	 * in any order. Of items with equal keys, only the first one is taken,
+	 * as by insertions one by one.
+	 * Items are sorted by up to threads threads (all hardware threads if 0),
+	 * and balanced tree is built by them as well.
+	 * All pointers, iterators and references of the tree are invalidated.
+	 *
+	 * @Time complexity: O(n + p*log(p)/t + p), where p is size of the range,
+	 *     and t is number of threads.
+	 * @Memory complexity: O(p)
+	 */
+	template<typename ForwardIt>
+	void build_parallel(ForwardIt first, ForwardIt last, unsigned threads = 0) {
+		if (!threads)
+			threads = std::thread::hardware_concurrency();
+		std::vector<std::pair<Key, const Value*> > items;
+		items.reserve(std::distance(first, last));
+		for (; first != last; ++first) {
+			items.push_back(std::make_pair(first->first, &first->second));
+		}
+		aux::parallel_stable_sort(items.begin(), items.end(), item_less,
+				threads);
+		items.erase(std::unique(items.begin(), items.end(), item_equal),
+				items.end());
+		Node *tmp_root = tree_from_items(items.data(), 0, (int) items.size() - 1,
+				threads);
+		clear();
+		root = tmp_root;
+	}
+
 	/* Efficient tree merge.
 	 * Trees' nodes are copied to sorted temporary array and then merged tree
 	 * is built, as if merged array was in-order of existing tree.
@@ -609,7 +2558,36 @@ public:
 	 *     and joining tree.
 	 * @Memory complexity: O(m+n)
 	 */
-	void merge(const AVL<Key, Value>& t) {
+	void merge(const AVL& t) {
+		merge(t, true);
+	}
+
+	/* Same as merge(t), but items of both trees, for which skip(key) is
+	 * true, are left out (e.g. removed keys). Keys are passed to skip in
+	 * ascending order, so it can walk a sorted sequence alongside.
+	 *
+	 * @Time complexity: O(m+n), and m+n calls of skip.
+	 * @Memory complexity: O(m+n)
+	 */
+	template<typename Skip>
+	void merge_except(const AVL& t, Skip skip) {
+		merge(t, true, skip);
+	}
+
+	~AVL() {
+		clear();
+	}
+
+protected:
+	/* Tree merge, as above. If not unique, items with same keys from both
+	 * trees are kept.
+	 */
+	void merge(const AVL& t, bool unique) {
+		merge(t, unique, aux::skip_none());
+	}
+
+	template<typename Skip>
+	void merge(const AVL& t, bool unique, Skip skip) {
 		int merged_size = size() + t.size();
 		Key* keys = new Key[merged_size];
 		Value** values;
@@ -619,18 +2597,13 @@ public:
 			delete[] keys;
 			throw;
 		}
-		merged_size = trees_to_arrays(t, keys, values);
+		merged_size = trees_to_arrays(t, keys, values, unique, skip);
 		Node * tmp_root = tree_from_array(keys, values, 0, merged_size - 1);
 		clear();
 		root = tmp_root;
 		delete[] values;
 		delete[] keys;
 	}
-
-	~AVL() {
-		clear();
-	}
-
 };
 
 #endif /* AVL_HPP_ */
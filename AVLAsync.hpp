@@ -0,0 +1,246 @@
+/*
+ * AVLAsync.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef AVLASYNC_HPP_
+#define AVLASYNC_HPP_
+
+/* Coroutine lookups need C++20 (e.g. g++ -std=c++20). Without it, this
+ * header provides nothing.
+ */
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define AVL_HAS_COROUTINES 1
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "AVL.hpp"
+
+/* Interleaves suspended lookups on a single thread. A lookup prefetches
+ * the node it needs next and suspends, so while one waits for its cache
+ * miss, the others run, and many misses are in flight at a time.
+ * Suspended lookups are resumed round-robin by run(), e.g. from an event
+ * loop, between its other work.
+ */
+class LookupScheduler {
+	std::deque<std::coroutine_handle<> > ready;
+
+public:
+	/* Awaitable, which prefetches given address, and queues the awaiting
+	 * coroutine for resumption. */
+	struct prefetchAwaiter {
+		LookupScheduler& scheduler;
+		const void* address;
+		bool await_ready() const noexcept {
+			return false;
+		}
+		void await_suspend(std::coroutine_handle<> h) {
+#ifdef __GNUC__
+			__builtin_prefetch(address);
+#endif
+			scheduler.ready.push_back(h);
+		}
+		void await_resume() const noexcept {}
+	};
+
+	prefetchAwaiter prefetch(const void* address) {
+		return prefetchAwaiter{ *this, address };
+	}
+
+	/* Queues coroutine h for resumption. */
+	void schedule(std::coroutine_handle<> h) {
+		ready.push_back(h);
+	}
+
+	/* Resumes the first queued coroutine.
+	 * @Return: false if there was none.
+	 * @Time complexity: O(1), and a step of the coroutine.
+	 */
+	bool run_one() {
+		if (ready.empty())
+			return false;
+		std::coroutine_handle<> h = ready.front();
+		ready.pop_front();
+		h.resume();
+		return true;
+	}
+
+	/* Resumes queued coroutines until none is left. */
+	void run() {
+		while (run_one()) {}
+	}
+
+	bool empty() const {
+		return ready.empty();
+	}
+};
+
+/* Lazily started coroutine, which returns T. Started either by co_await
+ * from another coroutine, which is resumed when task returns, or by
+ * start(), with no continuation (e.g. from plain code, which then runs the
+ * scheduler, and takes result()). Task must outlive its coroutine, i.e.
+ * must not be destroyed before it's done.
+ */
+template<typename T>
+class LookupTask {
+public:
+	struct promise_type;
+	typedef std::coroutine_handle<promise_type> handle;
+
+	struct promise_type {
+		std::optional<T> value; // T may be not default-constructible
+		std::exception_ptr error;
+		std::coroutine_handle<> continuation;
+
+		LookupTask get_return_object() {
+			return LookupTask(handle::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept {
+			return std::suspend_always();
+		}
+		/* Transfers control to the continuation, if any. */
+		struct finalAwaiter {
+			bool await_ready() noexcept {
+				return false;
+			}
+			std::coroutine_handle<> await_suspend(handle h) noexcept {
+				std::coroutine_handle<> next = h.promise().continuation;
+				return next ? next : std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+		finalAwaiter final_suspend() noexcept {
+			return finalAwaiter();
+		}
+		void return_value(T v) {
+			value = std::move(v);
+		}
+		void unhandled_exception() {
+			error = std::current_exception();
+		}
+	};
+
+	LookupTask(LookupTask&& t) noexcept : coroutine(t.coroutine) {
+		t.coroutine = handle();
+	}
+	LookupTask(const LookupTask&) = delete;
+	LookupTask& operator=(const LookupTask&) = delete;
+	~LookupTask() {
+		if (coroutine)
+			coroutine.destroy();
+	}
+
+	/* Awaiting coroutine is resumed with the result, when task returns. */
+	bool await_ready() const noexcept {
+		return false;
+	}
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+		coroutine.promise().continuation = h;
+		return coroutine;
+	}
+	T await_resume() {
+		return result();
+	}
+
+	/* Queues the task to run by scheduler s. */
+	void start(LookupScheduler& s) {
+		s.schedule(coroutine);
+	}
+
+	bool done() const {
+		return coroutine.done();
+	}
+
+	/* @Return: returned value. Rethrows, if task has thrown.
+	 * Assumes the task is done. */
+	T result() {
+		if (coroutine.promise().error)
+			std::rethrow_exception(coroutine.promise().error);
+		return std::move(*coroutine.promise().value);
+	}
+
+private:
+	handle coroutine;
+	explicit LookupTask(handle h) : coroutine(h) {}
+};
+
+/* AVL tree with pipelined lookups: co_find() is a coroutine, which
+ * suspends before each node it visits, so a scheduler can interleave many
+ * of them. Pays off for trees far larger than the cache, where each level
+ * of a search is a cache miss. Tree must not change, and must outlive the
+ * lookups, while they run.
+ *
+ * @Requirements from Key: same as in AVL, and copy-constructible.
+ * @Requirements from Value: same as in AVL.
+ */
+template<typename Key, typename Value, typename Augment = NoAugment>
+class AsyncAVL: public AVL<Key, Value, Augment> {
+	typedef AVL<Key, Value, Augment> Base;
+	typedef typename Base::Node Node;
+
+public:
+	typedef typename Base::iterator iterator;
+
+	/* Number of lookups, which find_batch() keeps in flight. */
+	enum { BATCH_WIDTH = 32 };
+
+	AsyncAVL() {}
+	AsyncAVL(const Base& t) : Base(t) {}
+
+	/* Searches the tree for item with key k, suspending before each visited
+	 * node, to be resumed by scheduler s. Key is copied into the coroutine.
+	 *
+	 * @Return: task, which returns in-order iterator to element with key k,
+	 *     or iterator to end() if item isn't present.
+	 * @Time complexity: O(log(n))
+	 */
+	LookupTask<iterator> co_find(Key k, LookupScheduler& s) const {
+		Node* r = this->root;
+		while (r) {
+			co_await s.prefetch(r);
+			if (k < r->key) {
+				r = r->left;
+			} else if (r->key < k) {
+				r = r->right;
+			} else {
+				co_return Base::iterator_at(r);
+			}
+		}
+		co_return this->end();
+	}
+
+	/* Searches keys of range [first, last), BATCH_WIDTH lookups at a time,
+	 * and writes iterators to found items (or end()) to out, in order.
+	 *
+	 * @Time complexity: O(p*log(n)), where p is size of the range.
+	 * @Memory complexity: O(1)
+	 */
+	template<typename InputIt, typename OutputIt>
+	OutputIt find_batch(InputIt first, InputIt last, OutputIt out) const {
+		LookupScheduler s;
+		std::deque<LookupTask<iterator> > tasks;
+		while (first != last || !tasks.empty()) {
+			while (first != last && tasks.size() < BATCH_WIDTH) {
+				tasks.push_back(co_find(*first, s));
+				tasks.back().start(s);
+				++first;
+			}
+			// Results are taken in order, the rest keep running meanwhile.
+			while (!tasks.front().done()) {
+				s.run_one();
+			}
+			*out = tasks.front().result();
+			++out;
+			tasks.pop_front();
+		}
+		return out;
+	}
+};
+
+#endif /* __cpp_impl_coroutine */
+
+#endif /* AVLASYNC_HPP_ */
@@ -0,0 +1,80 @@
+/*
+ * AVLAsync_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <map>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "AVLAsync.hpp"
+
+#ifdef AVL_HAS_COROUTINES
+
+typedef AsyncAVL<int, std::string> Tree;
+
+TEST(AsyncAVL, find_batch) {
+	Tree tree;
+	std::map<int, std::string> reference;
+	for (int i = 0; i < 5000; ++i) {
+		tree.insert(i * 3, std::to_string(i));
+		reference[i * 3] = std::to_string(i);
+	}
+	std::vector<int> keys;
+	for (int i = 0; i < 1000; ++i) {
+		keys.push_back(i * 7919 % 16000 - 100);
+	}
+	std::vector<Tree::iterator> found;
+	tree.find_batch(keys.begin(), keys.end(), std::back_inserter(found));
+	ASSERT_EQ(found.size(), keys.size());
+	for (size_t i = 0; i < keys.size(); ++i) {
+		if (reference.count(keys[i])) {
+			ASSERT_EQ(found[i].key(), keys[i]);
+			ASSERT_EQ(*found[i], reference[keys[i]]);
+		} else {
+			ASSERT_EQ(found[i], tree.end());
+		}
+	}
+	found.clear();
+	tree.find_batch(keys.begin(), keys.begin(), std::back_inserter(found));
+	ASSERT_TRUE(found.empty());
+}
+
+/* Request handler of an event loop: awaits several lookups. */
+static LookupTask<int> handler(const Tree& tree, int first,
+		LookupScheduler& s) {
+	int found = 0;
+	for (int k = first; k < first + 10; ++k) {
+		Tree::iterator it = co_await tree.co_find(k, s);
+		if (it != tree.end())
+			++found;
+	}
+	co_return found;
+}
+
+TEST(AsyncAVL, awaited_by_handlers) {
+	Tree tree;
+	for (int i = 0; i < 1000; i += 2) {
+		tree.insert(i, "");
+	}
+	LookupScheduler s;
+	std::vector<LookupTask<int> > handlers;
+	for (int i = 0; i < 20; ++i) {
+		handlers.push_back(handler(tree, i * 50 + i % 2, s));
+		handlers.back().start(s);
+	}
+	s.run();
+	ASSERT_TRUE(s.empty());
+	for (int i = 0; i < 20; ++i) {
+		ASSERT_TRUE(handlers[i].done());
+		ASSERT_EQ(handlers[i].result(), 5);
+	}
+	Tree empty;
+	LookupTask<Tree::iterator> lookup = empty.co_find(1, s);
+	lookup.start(s);
+	s.run();
+	ASSERT_EQ(lookup.result(), empty.end());
+}
+
+#endif
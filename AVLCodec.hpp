@@ -0,0 +1,100 @@
+/*
+ * AVLCodec.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef AVLCODEC_HPP_
+#define AVLCODEC_HPP_
+
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <stdint.h>
+
+/* Binary codecs, used to write keys and values to streams (see AVL::save()).
+ * Codec for type T must define:
+ *     static void write(std::ostream&, const T&)
+ *     static T read(std::istream&) - on failure sets failbit of the stream,
+ *         returned object is unspecified then.
+ *
+ * Default codec writes integral types in little-endian byte order, and any
+ * other trivially copyable type as is (so such data isn't portable between
+ * platforms with different representation). Specialize it, or pass another
+ * codec, for other types.
+ */
+template<typename T, bool integral = std::is_integral<T>::value>
+struct BinaryCodec {
+	static void write(std::ostream& os, const T& x) {
+		static_assert(std::is_trivially_copyable<T>::value,
+				"no default codec for this type, specialize BinaryCodec");
+		os.write(reinterpret_cast<const char*>(&x), sizeof(T));
+	}
+	static T read(std::istream& is) {
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type buffer;
+		std::memset(&buffer, 0, sizeof(T));
+		is.read(reinterpret_cast<char*>(&buffer), sizeof(T));
+		return *reinterpret_cast<T*>(&buffer);
+	}
+};
+
+template<typename T>
+struct BinaryCodec<T, true> {
+	static void write(std::ostream& os, const T& x) {
+		typedef typename std::make_unsigned<T>::type U;
+		U u = static_cast<U>(x);
+		char bytes[sizeof(T)];
+		for (unsigned int i = 0; i < sizeof(T); ++i) {
+			bytes[i] = static_cast<char>(u & 0xff);
+			u = static_cast<U>(u >> 8);
+		}
+		os.write(bytes, sizeof(T));
+	}
+	static T read(std::istream& is) {
+		typedef typename std::make_unsigned<T>::type U;
+		unsigned char bytes[sizeof(T)] = { 0 };
+		is.read(reinterpret_cast<char*>(bytes), sizeof(T));
+		U u = 0;
+		for (unsigned int i = sizeof(T); i > 0; --i) {
+			u = static_cast<U>(u << 8 | bytes[i - 1]);
+		}
+		return static_cast<T>(u);
+	}
+};
+
+template<>
+struct BinaryCodec<bool, true> {
+	static void write(std::ostream& os, const bool& x) {
+		os.put(x ? 1 : 0);
+	}
+	static bool read(std::istream& is) {
+		return is.get() == 1;
+	}
+};
+
+/* Strings are written as 64-bit length, followed by characters. */
+template<>
+struct BinaryCodec<std::string, false> {
+	static void write(std::ostream& os, const std::string& s) {
+		BinaryCodec<uint64_t>::write(os, s.size());
+		os.write(s.data(), s.size());
+	}
+	static std::string read(std::istream& is) {
+		uint64_t size = BinaryCodec<uint64_t>::read(is);
+		std::string s;
+		// Read in bounded chunks, so a corrupted length fails on end of
+		// stream instead of allocating it all up front.
+		char chunk[4096];
+		while (is && size > 0) {
+			std::streamsize n = size < sizeof(chunk) ? size : sizeof(chunk);
+			is.read(chunk, n);
+			s.append(chunk, is.gcount());
+			size -= n;
+		}
+		return s;
+	}
+};
+
+#endif /* AVLCODEC_HPP_ */
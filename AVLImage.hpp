@@ -0,0 +1,293 @@
+/*
+ * AVLImage.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef AVLIMAGE_HPP_
+#define AVLIMAGE_HPP_
+
+#include <cstring>
+#include <ostream>
+#include <type_traits>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "AVL.hpp"
+
+/* Read-only dictionary image, which is queried in place, e.g. directly in
+ * a memory-mapped file. Image contains no pointers, so it can be shared by
+ * processes, and opening it takes no time, regardless of its size.
+ *
+ * Image is the implicit form of the balanced tree, built by AVL from sorted
+ * arrays: items are stored in ascending order of keys, root of range
+ * [from, to] is the item in its middle, and its subtrees are the two halves.
+ * So the search descends exactly as in such tree, with child positions
+ * computed instead of stored, and in-order traversal is a sequential scan.
+ *
+ * Layout (native byte order, sizes are recorded and checked on open):
+ *     header, padded to HEADER_SIZE bytes,
+ *     count entries of entry_size bytes: key at offset 0, value at
+ *     value_offset.
+ *
+ * @Requirements from Key: trivially copyable, has operator< implemented.
+ * @Requirements from Value: trivially copyable.
+ */
+template<typename Key, typename Value>
+class AVLImage {
+	static_assert(std::is_trivially_copyable<Key>::value,
+			"image key must be trivially copyable");
+	static_assert(std::is_trivially_copyable<Value>::value,
+			"image value must be trivially copyable");
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t count;
+		uint32_t key_size;
+		uint32_t value_size;
+		uint32_t value_offset;
+		uint32_t entry_size;
+	};
+
+	enum {
+		IMAGE_MAGIC = 0x49564141, // "AAVI"
+		IMAGE_VERSION = 1,
+		HEADER_SIZE = 64,
+		VALUE_OFFSET = (sizeof(Key) + alignof(Value) - 1) / alignof(Value)
+				* alignof(Value),
+		ALIGNMENT = alignof(Key) < alignof(Value) ? alignof(Value) : alignof(Key),
+		ENTRY_SIZE = (VALUE_OFFSET + sizeof(Value) + ALIGNMENT - 1) / ALIGNMENT
+				* ALIGNMENT
+	};
+	static_assert(ALIGNMENT <= HEADER_SIZE, "entries alignment is too large");
+
+	const char *entries;
+	int count;
+	void *mapping;
+	size_t mapping_size;
+
+	class imageIterator {
+		friend class AVLImage;
+		const char *entry;
+		imageIterator(const char* entry = NULL) : entry(entry) {}
+
+	public:
+		/* !IMPORTANT! iterator must be validated before.
+		 *     ++ on invalid iterators (e.g. end()) is undefined.
+		 * @Time complexity: O(1)
+		 */
+		imageIterator& operator++() {
+			entry += ENTRY_SIZE;
+			return *this;
+		}
+		imageIterator operator++(int) {
+			imageIterator copy(*this);
+			++(*this);
+			return copy;
+		}
+		bool operator==(const imageIterator& it) const {
+			return entry == it.entry;
+		}
+		bool operator!=(const imageIterator& it) const {
+			return !(*this == it);
+		}
+
+		/* !IMPORTANT! iterator must be validated before dereferencing.
+		 * @Return: reference to value in the image.
+		 */
+		const Value& operator*() const {
+			return value();
+		}
+		const Key& key() const {
+			return *reinterpret_cast<const Key*>(entry);
+		}
+		const Value& value() const {
+			return *reinterpret_cast<const Value*>(entry + VALUE_OFFSET);
+		}
+	};
+
+	const char* entry_at(int i) const {
+		return entries + (size_t) i * ENTRY_SIZE;
+	}
+	const Key& key_at(int i) const {
+		return *reinterpret_cast<const Key*>(entry_at(i));
+	}
+
+	/* Descends the implicit tree for the first item with key not less than
+	 * k, or greater than k if strict.
+	 *
+	 * @Return: index of the item, or count if there is no such item.
+	 * @Time complexity: O(log(n))
+	 */
+	int bound(const Key& k, bool strict) const {
+		int from = 0, to = count - 1, candidate = count;
+		while (from <= to) {
+			int mid = from + (to - from) / 2;
+			if (strict ? !(k < key_at(mid)) : key_at(mid) < k) {
+				from = mid + 1;
+			} else {
+				candidate = mid;
+				to = mid - 1;
+			}
+		}
+		return candidate;
+	}
+
+	AVLImage(const AVLImage&) = delete;
+	AVLImage& operator=(const AVLImage&) = delete;
+
+public:
+	typedef imageIterator iterator;
+
+	/* Creates empty image, which isn't attached to any data.
+	 * @Time complexity: O(1)
+	 */
+	AVLImage() : entries(NULL), count(0), mapping(NULL), mapping_size(0) {}
+
+	~AVLImage() {
+		close();
+	}
+
+	/* Writes tree (of any augmentation, layout and balance) as an image.
+	 *
+	 * @Return: true if all data was written successfully.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	template<typename Augment, typename Layout, typename Balance>
+	static bool write(const AVL<Key, Value, Augment, Layout, Balance>& tree,
+			std::ostream& os) {
+		char header[HEADER_SIZE] = { 0 };
+		Header h;
+		std::memset(&h, 0, sizeof(h));
+		h.magic = IMAGE_MAGIC;
+		h.version = IMAGE_VERSION;
+		h.count = tree.size();
+		h.key_size = sizeof(Key);
+		h.value_size = sizeof(Value);
+		h.value_offset = VALUE_OFFSET;
+		h.entry_size = ENTRY_SIZE;
+		std::memcpy(header, &h, sizeof(h));
+		os.write(header, HEADER_SIZE);
+		char entry[ENTRY_SIZE];
+		std::memset(entry, 0, ENTRY_SIZE);
+		for (auto it = tree.begin(); it != tree.end() && os; ++it) {
+			Key k = it.key();
+			std::memcpy(entry, &k, sizeof(Key));
+			std::memcpy(entry + VALUE_OFFSET, &it.value(), sizeof(Value));
+			os.write(entry, ENTRY_SIZE);
+		}
+		return !os.fail();
+	}
+
+	/* Attaches image to data in memory (e.g. written by write()), which must
+	 * outlive the image, and be aligned as Key and Value. Data isn't copied.
+	 * If data isn't a valid image - image stays detached.
+	 *
+	 * @Return: true if data is a valid image.
+	 * @Time complexity: O(1)
+	 */
+	bool attach(const void* data, size_t size) {
+		close();
+		Header h;
+		if (size < HEADER_SIZE)
+			return false;
+		std::memcpy(&h, data, sizeof(h));
+		if (h.magic != IMAGE_MAGIC || h.version != IMAGE_VERSION
+				|| h.key_size != sizeof(Key) || h.value_size != sizeof(Value)
+				|| h.value_offset != VALUE_OFFSET || h.entry_size != ENTRY_SIZE
+				|| h.count > (uint64_t) std::numeric_limits<int>::max()
+				|| (size - HEADER_SIZE) / ENTRY_SIZE < h.count)
+			return false;
+		entries = static_cast<const char*>(data) + HEADER_SIZE;
+		count = (int) h.count;
+		return true;
+	}
+
+	/* Maps image file to memory (read-only, shared with other processes)
+	 * and attaches to it. Nothing is read or allocated until items are
+	 * accessed.
+	 *
+	 * @Return: true if file was mapped, and it is a valid image.
+	 * @Time complexity: O(1)
+	 */
+	bool open(const char* path) {
+		close();
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		void* data = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+		if (data == MAP_FAILED)
+			return false;
+		if (!attach(data, st.st_size)) {
+			munmap(data, st.st_size);
+			return false;
+		}
+		mapping = data;
+		mapping_size = st.st_size;
+		return true;
+	}
+
+	/* Detaches image, and unmaps the file, if it was mapped by open().
+	 * @Time complexity: O(1)
+	 */
+	void close() {
+		if (mapping)
+			munmap(mapping, mapping_size);
+		mapping = NULL;
+		mapping_size = 0;
+		entries = NULL;
+		count = 0;
+	}
+
+	iterator begin() const {
+		return iterator(entries);
+	}
+	iterator end() const {
+		return iterator(entry_at(count));
+	}
+
+	/* @Return: number of items, O(1). */
+	int size() const {
+		return count;
+	}
+	bool empty() const {
+		return !count;
+	}
+
+	/* Searches the image for item with key k.
+	 *
+	 * @Return: iterator to item with key k, or end() if it isn't present.
+	 * @Time complexity: O(log(n))
+	 */
+	iterator find(const Key& k) const {
+		int i = bound(k, false);
+		if (i == count || k < key_at(i))
+			return end();
+		return iterator(entry_at(i));
+	}
+
+	/* @Return: iterator to the first item with key not less than k, or end().
+	 * @Time complexity: O(log(n))
+	 */
+	iterator lower_bound(const Key& k) const {
+		return iterator(entry_at(bound(k, false)));
+	}
+
+	/* @Return: iterator to the first item with key greater than k, or end().
+	 * @Time complexity: O(log(n))
+	 */
+	iterator upper_bound(const Key& k) const {
+		return iterator(entry_at(bound(k, true)));
+	}
+};
+
+#endif /* AVLIMAGE_HPP_ */
@@ -0,0 +1,95 @@
+/*
+ * AVLImage_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include "AVLImage.hpp"
+
+struct Point {
+	double x, y;
+};
+
+/* Writes image of tree to a temporary file. @Return: path of the file. */
+template<typename Tree>
+static std::string write_image_file(const Tree& tree) {
+	char path[] = "/tmp/avl_image_XXXXXX";
+	int fd = mkstemp(path);
+	close(fd);
+	std::ofstream file(path, std::ios::binary);
+	AVLImage<int, Point>::write(tree, file);
+	return path;
+}
+
+TEST(AVLImage, open_and_query_mapped_file) {
+	AVL<int, Point> tree;
+	for (int i = 0; i < 1000; ++i) {
+		tree.insert(i * 3, Point { i * 0.5, -i * 1.0 });
+	}
+	std::string path = write_image_file(tree);
+	AVLImage<int, Point> image;
+	ASSERT_TRUE(image.open(path.c_str()));
+	std::remove(path.c_str());
+	ASSERT_EQ(image.size(), 1000);
+	ASSERT_EQ(image.find(300).value().x, 50.0);
+	ASSERT_EQ(image.find(301), image.end());
+	ASSERT_EQ(image.find(-3), image.end());
+	ASSERT_EQ(image.lower_bound(301).key(), 303);
+	ASSERT_EQ(image.upper_bound(303).key(), 306);
+	ASSERT_EQ(image.lower_bound(2998), image.end());
+	auto j = tree.begin();
+	for (auto it = image.begin(); it != image.end(); ++it, ++j) {
+		ASSERT_EQ(it.key(), j.key());
+		ASSERT_EQ((*it).y, (*j).y);
+	}
+	ASSERT_EQ(j, tree.end());
+}
+
+TEST(AVLImage, empty_image) {
+	AVL<int, Point> tree;
+	std::stringstream stream;
+	ASSERT_TRUE((AVLImage<int, Point>::write(tree, stream)));
+	std::string data = stream.str();
+	AVLImage<int, Point> image;
+	ASSERT_TRUE(image.attach(data.data(), data.size()));
+	ASSERT_TRUE(image.empty());
+	ASSERT_EQ(image.begin(), image.end());
+	ASSERT_EQ(image.find(1), image.end());
+}
+
+TEST(AVLImage, rejects_invalid_data) {
+	AVL<int, Point> tree;
+	tree.insert(1, Point { 1, 1 });
+	std::stringstream stream;
+	AVLImage<int, Point>::write(tree, stream);
+	std::string data = stream.str();
+	AVLImage<int, Point> image;
+	ASSERT_FALSE(image.attach(data.data(), data.size() - 1));
+	AVLImage<int, int> wrong_type;
+	ASSERT_FALSE(wrong_type.attach(data.data(), data.size()));
+	ASSERT_FALSE(image.open("/nonexistent/avl_image"));
+	ASSERT_TRUE(image.attach(data.data(), data.size()));
+	ASSERT_EQ(image.find(1).value().y, 1);
+}
+
+TEST(AVLImage, write_any_layout_and_balance) {
+	AVL<int, Point, CountAugment, AncestorStack, WAVLBalance> tree;
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i * 7 % 100, Point { (double) (i * 7 % 100), 0 });
+	}
+	std::string path = write_image_file(tree);
+	AVLImage<int, Point> image;
+	ASSERT_TRUE(image.open(path.c_str()));
+	std::remove(path.c_str());
+	ASSERT_EQ(image.size(), 100);
+	int expected = 0;
+	for (auto it = image.begin(); it != image.end(); ++it, ++expected) {
+		ASSERT_EQ(it.key(), expected);
+		ASSERT_EQ((*it).x, expected);
+	}
+}
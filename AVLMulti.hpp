@@ -0,0 +1,156 @@
+/*
+ * AVLMulti.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef AVLMULTI_HPP_
+#define AVLMULTI_HPP_
+
+#include <utility>
+#include "AVL.hpp"
+
+/* AVL tree, which allows multiple items with same key (i.e. multimap).
+ * Items with same key are kept in order of insertion: insertion sends ties
+ * to the right, and neither rolls nor deletions change in-order sequence.
+ * Each node keeps size of its subtree (CountAugment), so items with some key
+ * are counted without visiting them.
+ *
+ * Inherited remove(k) and extract(k) remove a single item with key k, not
+ * necessarily the first one, extract(iterator) removes the item it points
+ * to. Inherited find(k) returns some item with key k, use equal_range(k) to
+ * get all of them.
+ *
+ * @Requirements from Key and Value: same as in AVL.
+ */
+template<typename Key, typename Value>
+class AVLMulti: public AVL<Key, Value, CountAugment> {
+	typedef AVL<Key, Value, CountAugment> Base;
+	typedef typename Base::Node Node;
+
+public:
+	typedef typename Base::iterator iterator;
+
+private:
+	/* Counts items in subtree r with keys less than k (or not greater than k,
+	 * if inclusive).
+	 *
+	 * @Time complexity: O(log(n))
+	 */
+	static int count_below(const Key& k, Node* r, bool inclusive) {
+		int count = 0;
+		while (r) {
+			if (inclusive ? !(k < r->key) : r->key < k) {
+				count += Base::subtree_aggregate(r->left) + 1;
+				r = r->right;
+			} else {
+				r = r->left;
+			}
+		}
+		return count;
+	}
+
+public:
+	/* Default C'tor. Creates empty tree.
+	 * @Time complexity: O(1)
+	 */
+	AVLMulti() {}
+
+	/* Inserts an item with given key k and value v. If there are items with
+	 * same key, new item is placed after them.
+	 *
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	void insert(const Key& k, const Value& v) {
+		this->root = Base::insert_r(k, v, this->root);
+	}
+
+	/* Links node of handle h back into the tree, after all items with same
+	 * key. Nothing is allocated or copied. Does nothing if h is empty.
+	 *
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	void insert(typename Base::node_handle&& h) {
+		if (!h.empty())
+			this->root = Base::insert_r(Base::release(h), this->root);
+	}
+
+	/* Counts items with key k.
+	 *
+	 * @Return: number of items with key k.
+	 * @Time complexity: O(log(n))
+	 */
+	int count(const Key& k) const {
+		return count_below(k, this->root, true)
+				- count_below(k, this->root, false);
+	}
+
+	/* Number of items in tree.
+	 *
+	 * @Return: number of items.
+	 * @Time complexity: O(1)
+	 */
+	int size() const {
+		return this->aggregate();
+	}
+
+	/* Finds all items with key k.
+	 *
+	 * @Return: pair of iterators - to the first item with key k, and to the
+	 *     item following the last one. If there are no such items, both
+	 *     point to the first item with greater key (or to end()).
+	 * @Time complexity: O(log(n))
+	 */
+	std::pair<iterator, iterator> equal_range(const Key& k) const {
+		return std::make_pair(this->lower_bound(k), this->upper_bound(k));
+	}
+
+	/* Removes all items with key k. Items are cut out of the tree by two
+	 * splits, and rest of the tree is joined back.
+	 *
+	 * @Return: number of removed items.
+	 * @Time complexity: O(log(n) + c), where c is number of removed items.
+	 * @Memory complexity: O(log(n))
+	 */
+	int erase(const Key& k) {
+		Node *less, *rest, *equal, *greater;
+		Base::split_r(this->root, k, false, less, rest);
+		Base::split_r(rest, k, true, equal, greater);
+		int removed = Base::subtree_aggregate(equal);
+		Base::destroy_r(equal);
+		this->root = Base::join(less, greater);
+		return removed;
+	}
+
+	/* Merges t into this tree. All items of both trees are kept, items with
+	 * same key from this tree precede those from t.
+	 * All pointers, iterators and references of this tree are invalidated.
+	 *
+	 * @Time complexity: O(m+n), where m and n are numbers of nodes in current
+	 *     and joining tree.
+	 * @Memory complexity: O(m+n)
+	 */
+	void merge(const AVLMulti& t) {
+		Base::merge(t, false);
+	}
+};
+
+/* Multiset: AVLMulti of keys only. */
+template<typename Key>
+class AVLMultiSet: public AVLMulti<Key, aux::none> {
+	typedef AVLMulti<Key, aux::none> Base;
+
+public:
+	/* Inserts key k after all equal keys.
+	 *
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	void insert(const Key& k) {
+		Base::insert(k, aux::none());
+	}
+};
+
+#endif /* AVLMULTI_HPP_ */
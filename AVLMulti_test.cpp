@@ -0,0 +1,140 @@
+/*
+ * AVLMulti_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <vector>
+#include <map>
+#include <gtest/gtest.h>
+#include "AVLMulti.hpp"
+
+TEST(AVLMulti, duplicates_in_insertion_order) {
+	AVLMulti<int, int> tree;
+	std::vector<int> k = { 5, 3, 5, 8, 5, 3, 1, 5 };
+	for (unsigned int i = 0; i < k.size(); ++i) {
+		tree.insert(k[i], i);
+	}
+	ASSERT_EQ(tree.size(), 8);
+	std::vector<int> fives;
+	auto range = tree.equal_range(5);
+	for (auto it = range.first; it != range.second; ++it) {
+		fives.push_back(*it);
+	}
+	ASSERT_EQ(fives, std::vector<int>({ 0, 2, 4, 7 }));
+}
+
+TEST(AVLMulti, count) {
+	AVLMulti<int, int> tree;
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i % 7, i);
+	}
+	ASSERT_EQ(tree.count(0), 15);
+	ASSERT_EQ(tree.count(6), 14);
+	ASSERT_EQ(tree.count(7), 0);
+	ASSERT_EQ(tree.count(-1), 0);
+}
+
+TEST(AVLMulti, equal_range_missing_key) {
+	AVLMulti<int, int> tree;
+	tree.insert(1, 1);
+	tree.insert(3, 3);
+	auto range = tree.equal_range(2);
+	ASSERT_EQ(range.first, range.second);
+	ASSERT_EQ(range.first.key(), 3);
+}
+
+TEST(AVLMulti, erase_all_duplicates) {
+	AVLMulti<int, int> tree;
+	for (int i = 0; i < 300; ++i) {
+		tree.insert(i % 10, i);
+	}
+	ASSERT_EQ(tree.erase(4), 30);
+	ASSERT_EQ(tree.erase(4), 0);
+	ASSERT_EQ(tree.count(4), 0);
+	ASSERT_EQ(tree.size(), 270);
+	int previous = -1;
+	for (auto it = tree.begin(); it != tree.end(); ++it) {
+		ASSERT_NE(it.key(), 4);
+		ASSERT_LE(previous, it.key());
+		previous = it.key();
+	}
+	ASSERT_EQ(tree.count(3), 30);
+}
+
+TEST(AVLMulti, random_against_multimap) {
+	AVLMulti<int, int> tree;
+	std::multimap<int, int> reference;
+	unsigned int seed = 3;
+	for (int i = 0; i < 3000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		int k = (seed / 65536) % 50;
+		if (i % 5 == 4) {
+			ASSERT_EQ(tree.erase(k), (int)reference.erase(k));
+		} else {
+			tree.insert(k, i);
+			reference.insert(std::make_pair(k, i));
+		}
+		ASSERT_EQ(tree.count(k), (int)reference.count(k));
+	}
+	auto expected = reference.begin();
+	for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+		ASSERT_EQ(it.key(), expected->first);
+		ASSERT_EQ(*it, expected->second);
+	}
+	ASSERT_EQ(expected, reference.end());
+}
+
+TEST(AVLMulti, merge_keeps_duplicates) {
+	AVLMulti<int, int> tree1, tree2;
+	tree1.insert(1, 10);
+	tree1.insert(2, 20);
+	tree2.insert(1, 11);
+	tree2.insert(3, 31);
+	tree1.merge(tree2);
+	ASSERT_EQ(tree1.size(), 4);
+	ASSERT_EQ(tree1.count(1), 2);
+	ASSERT_EQ(*tree1.lower_bound(1), 10);
+}
+
+TEST(AVLMulti, multiset) {
+	AVLMultiSet<int> set;
+	set.insert(2);
+	set.insert(2);
+	set.insert(1);
+	ASSERT_EQ(set.count(2), 2);
+	ASSERT_EQ(set.begin().key(), 1);
+}
+
+TEST(AVLMulti, reinsert_node_after_duplicates) {
+	AVLMulti<int, int> tree;
+	tree.insert(1, 10);
+	tree.insert(1, 11);
+	tree.insert(2, 20);
+	auto h = tree.extract(2);
+	h.key() = 1;
+	tree.insert(std::move(h));
+	ASSERT_EQ(tree.count(1), 3);
+	std::vector<int> values;
+	for (auto it = tree.begin(); it != tree.end(); ++it) {
+		values.push_back(*it);
+	}
+	ASSERT_EQ(values, std::vector<int>({ 10, 11, 20 }));
+}
+
+TEST(AVLMulti, extract_iterator_among_duplicates) {
+	AVLMulti<int, int> tree;
+	for (int i = 0; i < 3; ++i) {
+		tree.insert(1, 10 + i);
+	}
+	auto it = tree.begin();
+	++it;
+	auto h = tree.extract(it);
+	ASSERT_EQ(h.value(), 11);
+	std::vector<int> values;
+	for (auto i = tree.begin(); i != tree.end(); ++i) {
+		values.push_back(*i);
+	}
+	ASSERT_EQ(values, std::vector<int>({ 10, 12 }));
+	ASSERT_EQ(tree.size(), 2);
+}
@@ -0,0 +1,307 @@
+/*
+ * AVLTrace.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef AVLTRACE_HPP_
+#define AVLTRACE_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+#include "AVL.hpp"
+
+/* Workload traces: recording of operations on a tree, and their replay
+ * against any tree configuration (see replay_trace()).
+ *
+ * Trace is binary: header (magic, format version, key type, key size),
+ * followed by records.
+ * Record is an operation code (1 byte), followed by:
+ *     insert, find, remove - key,
+ *     merge - 64-bit number of keys of the merged tree, and the keys,
+ *     iterate - nothing.
+ * Keys are written by codec (see AVLCodec.hpp). Values aren't recorded, they
+ * are default-constructed on replay.
+ */
+enum TraceOperation {
+	TRACE_INSERT = 1,
+	TRACE_FIND,
+	TRACE_REMOVE,
+	TRACE_MERGE,
+	TRACE_ITERATE,
+	TRACE_OPERATIONS
+};
+
+/* How keys of a trace are written: by default codec (see AVLCodec.hpp) as
+ * a signed or unsigned integer, a string, or as is (other trivially
+ * copyable types); or by another codec.
+ */
+enum TraceKeyType {
+	TRACE_KEY_CUSTOM,
+	TRACE_KEY_SIGNED,
+	TRACE_KEY_UNSIGNED,
+	TRACE_KEY_STRING,
+	TRACE_KEY_RAW
+};
+
+/* Key type of a trace, as recorded in its header. */
+struct TraceKey {
+	uint32_t type; // TraceKeyType
+	uint32_t size; // sizeof(Key)
+	bool operator==(const TraceKey& k) const {
+		return type == k.type && size == k.size;
+	}
+};
+
+template<typename Key>
+struct TraceRecord {
+	int op;
+	Key key; // insert, find, remove
+	std::vector<Key> keys; // merge
+};
+
+namespace aux {
+enum {
+	TRACE_MAGIC = 0x54565641, // "AVVT"
+	TRACE_VERSION = 2
+};
+
+template<typename Key, typename KeyCodec>
+struct trace_key_type {
+	enum { value = TRACE_KEY_CUSTOM };
+};
+template<typename Key, bool integral>
+struct trace_key_type<Key, BinaryCodec<Key, integral> > {
+	enum {
+		value = !integral ? TRACE_KEY_RAW
+				: std::is_signed<Key>::value ? TRACE_KEY_SIGNED
+				: TRACE_KEY_UNSIGNED
+	};
+};
+template<>
+struct trace_key_type<std::string, BinaryCodec<std::string> > {
+	enum { value = TRACE_KEY_STRING };
+};
+}
+
+/* @Return: key type of traces of Key, written by KeyCodec. */
+template<typename Key, typename KeyCodec>
+TraceKey trace_key() {
+	TraceKey k = { aux::trace_key_type<Key, KeyCodec>::value, sizeof(Key) };
+	return k;
+}
+
+template<typename Key>
+TraceKey trace_key() {
+	return trace_key<Key, BinaryCodec<Key> >();
+}
+
+/* Reads trace header, e.g. to choose key type for read_trace().
+ *
+ * @Return: false if stream isn't a trace (of this format version).
+ * @Time complexity: O(1)
+ */
+inline bool read_trace_header(std::istream& is, TraceKey& key) {
+	if (BinaryCodec<uint32_t>::read(is) != aux::TRACE_MAGIC
+			|| BinaryCodec<uint32_t>::read(is) != aux::TRACE_VERSION)
+		return false;
+	key.type = BinaryCodec<uint32_t>::read(is);
+	key.size = BinaryCodec<uint32_t>::read(is);
+	return !is.fail();
+}
+
+/* AVL tree, which records its operations to a trace stream: insert, find,
+ * remove, merge, and iteration (each begin() is recorded as a traversal).
+ * Other operations aren't recorded. Stream must outlive the tree, and
+ * is written without flushing, as operations are done.
+ *
+ * @Requirements from Key, Value: same as in AVL; key is written by KeyCodec.
+ */
+template<typename Key, typename Value, typename Augment = NoAugment,
+		typename KeyCodec = BinaryCodec<Key> >
+class TracedAVL: public AVL<Key, Value, Augment> {
+	typedef AVL<Key, Value, Augment> Base;
+
+	std::ostream& trace;
+
+	void record(int op) const {
+		trace.put((char) op);
+	}
+	void record(int op, const Key& k) const {
+		record(op);
+		KeyCodec::write(trace, k);
+	}
+
+	TracedAVL(const TracedAVL&) = delete;
+	TracedAVL& operator=(const TracedAVL&) = delete;
+
+public:
+	typedef typename Base::iterator iterator;
+
+	/* Creates empty tree, and writes trace header.
+	 * @Time complexity: O(1)
+	 */
+	explicit TracedAVL(std::ostream& trace) : trace(trace) {
+		TraceKey key = trace_key<Key, KeyCodec>();
+		BinaryCodec<uint32_t>::write(trace, aux::TRACE_MAGIC);
+		BinaryCodec<uint32_t>::write(trace, aux::TRACE_VERSION);
+		BinaryCodec<uint32_t>::write(trace, key.type);
+		BinaryCodec<uint32_t>::write(trace, key.size);
+	}
+
+	/* Recorded versions of AVL operations, same complexity (for merge -
+	 * plus writing keys of t).
+	 */
+	bool insert(const Key& k, const Value& v) {
+		record(TRACE_INSERT, k);
+		return Base::insert(k, v);
+	}
+
+	iterator find(const Key& k) const {
+		record(TRACE_FIND, k);
+		return Base::find(k);
+	}
+
+	void remove(const Key& k) {
+		record(TRACE_REMOVE, k);
+		Base::remove(k);
+	}
+
+	void merge(const Base& t) {
+		record(TRACE_MERGE);
+		BinaryCodec<uint64_t>::write(trace, t.size());
+		for (iterator it = t.begin(); it != t.end(); ++it) {
+			KeyCodec::write(trace, it.key());
+		}
+		Base::merge(t);
+	}
+
+	iterator begin() const {
+		record(TRACE_ITERATE);
+		return Base::begin();
+	}
+};
+
+/* Reads whole trace from stream.
+ *
+ * @Return: false if stream isn't a trace of Key written by KeyCodec, or it
+ *     is corrupted. Records read before the error are kept in records.
+ * @Time complexity: O(r), where r is size of the trace.
+ */
+template<typename Key, typename KeyCodec>
+bool read_trace(std::istream& is, std::vector<TraceRecord<Key> >& records) {
+	TraceKey key;
+	if (!read_trace_header(is, key) || !(key == trace_key<Key, KeyCodec>()))
+		return false;
+	int op;
+	while ((op = is.get()) != std::istream::traits_type::eof()) {
+		TraceRecord<Key> r;
+		r.op = op;
+		if (op == TRACE_INSERT || op == TRACE_FIND || op == TRACE_REMOVE) {
+			r.key = KeyCodec::read(is);
+		} else if (op == TRACE_MERGE) {
+			uint64_t count = BinaryCodec<uint64_t>::read(is);
+			// Count isn't trusted for reservation, a corrupted one fails on
+			// end of stream.
+			for (uint64_t i = 0; i < count && is; ++i) {
+				r.keys.push_back(KeyCodec::read(is));
+			}
+		} else if (op != TRACE_ITERATE) {
+			return false;
+		}
+		if (!is)
+			return false;
+		records.push_back(r);
+	}
+	return true;
+}
+
+template<typename Key>
+bool read_trace(std::istream& is, std::vector<TraceRecord<Key> >& records) {
+	return read_trace<Key, BinaryCodec<Key> >(is, records);
+}
+
+/* Results of trace replay. Latencies are in nanoseconds, per operation
+ * type (indexed by TraceOperation).
+ */
+struct TraceReport {
+	enum { P50, P90, P99, P999, MAX, PERCENTILES };
+
+	int64_t count[TRACE_OPERATIONS];
+	int64_t latency[TRACE_OPERATIONS][PERCENTILES];
+	double seconds; // total time of all operations
+	double ops_per_second;
+};
+
+/* Replays trace against tree. Tree may be of any type, which has AVL-like
+ * insert(k, v), find(k), end(), remove(k), merge(const Tree&) and begin().
+ * Values are default-constructed Value objects. Each operation is timed
+ * separately, preparation of merged trees isn't timed.
+ *
+ * @Return: throughput and latency percentiles.
+ * @Time complexity: as operations of the trace, plus O(r*log(r)) for
+ *     percentiles, where r is number of records.
+ */
+template<typename Value, typename Tree, typename Key>
+TraceReport replay_trace(const std::vector<TraceRecord<Key> >& records,
+		Tree& tree) {
+	typedef std::chrono::steady_clock clock;
+	std::vector<int64_t> latencies[TRACE_OPERATIONS];
+	int64_t total = 0;
+	volatile int64_t sink = 0;
+	for (size_t i = 0; i < records.size(); ++i) {
+		const TraceRecord<Key>& r = records[i];
+		Tree other;
+		if (r.op == TRACE_MERGE) {
+			for (size_t j = 0; j < r.keys.size(); ++j) {
+				other.insert(r.keys[j], Value());
+			}
+		}
+		clock::time_point start = clock::now();
+		switch (r.op) {
+		case TRACE_INSERT:
+			tree.insert(r.key, Value());
+			break;
+		case TRACE_FIND:
+			sink = sink + (tree.find(r.key) != tree.end());
+			break;
+		case TRACE_REMOVE:
+			tree.remove(r.key);
+			break;
+		case TRACE_MERGE:
+			tree.merge(other);
+			break;
+		case TRACE_ITERATE:
+			for (auto it = tree.begin(); it != tree.end(); ++it) {
+				sink = sink + 1;
+			}
+			break;
+		}
+		int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				clock::now() - start).count();
+		latencies[r.op].push_back(ns);
+		total += ns;
+	}
+	TraceReport report;
+	const double percentiles[] = { 0.5, 0.9, 0.99, 0.999, 1 };
+	for (int op = 0; op < TRACE_OPERATIONS; ++op) {
+		std::vector<int64_t>& l = latencies[op];
+		std::sort(l.begin(), l.end());
+		report.count[op] = l.size();
+		for (int p = 0; p < TraceReport::PERCENTILES; ++p) {
+			size_t at = std::min(l.size() - 1, (size_t) (percentiles[p] * l.size()));
+			report.latency[op][p] = l.empty() ? 0 : l[at];
+		}
+	}
+	report.seconds = total / 1e9;
+	report.ops_per_second = total ? records.size() / report.seconds : 0;
+	return report;
+}
+
+#endif /* AVLTRACE_HPP_ */
@@ -0,0 +1,115 @@
+/*
+ * AVLTrace_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include "AVLTrace.hpp"
+
+TEST(AVLTrace, record_and_read) {
+	std::stringstream trace;
+	{
+		TracedAVL<int, int> tree(trace);
+		tree.insert(5, 50);
+		tree.insert(3, 30);
+		ASSERT_NE(tree.find(5), tree.end());
+		tree.remove(3);
+		AVL<int, int> other;
+		other.insert(7, 70);
+		other.insert(9, 90);
+		tree.merge(other);
+		int count = 0;
+		for (auto it = tree.begin(); it != tree.end(); ++it) {
+			++count;
+		}
+		ASSERT_EQ(count, 3);
+	}
+	std::vector<TraceRecord<int> > records;
+	ASSERT_TRUE(read_trace(trace, records));
+	ASSERT_EQ(records.size(), 6U);
+	int ops[] = { TRACE_INSERT, TRACE_INSERT, TRACE_FIND, TRACE_REMOVE,
+			TRACE_MERGE, TRACE_ITERATE };
+	for (int i = 0; i < 6; ++i) {
+		ASSERT_EQ(records[i].op, ops[i]);
+	}
+	ASSERT_EQ(records[0].key, 5);
+	ASSERT_EQ(records[1].key, 3);
+	ASSERT_EQ(records[3].key, 3);
+	ASSERT_EQ(records[4].keys, std::vector<int>({ 7, 9 }));
+}
+
+TEST(AVLTrace, read_corrupted) {
+	std::vector<TraceRecord<int> > records;
+	std::stringstream empty;
+	ASSERT_FALSE(read_trace(empty, records));
+	std::stringstream trace;
+	{
+		TracedAVL<int, int> tree(trace);
+		tree.insert(1, 1);
+		tree.insert(2, 2);
+	}
+	std::string data = trace.str();
+	std::stringstream truncated(data.substr(0, data.size() - 1));
+	ASSERT_FALSE(read_trace(truncated, records));
+	ASSERT_EQ(records.size(), 1U);
+	records.clear();
+	std::stringstream bad_op(data + "\x7f");
+	ASSERT_FALSE(read_trace(bad_op, records));
+}
+
+TEST(AVLTrace, key_type_in_header) {
+	std::stringstream trace;
+	{
+		TracedAVL<int, int> tree(trace);
+		tree.insert(1, 1);
+	}
+	std::string data = trace.str();
+	std::stringstream header(data);
+	TraceKey key;
+	ASSERT_TRUE(read_trace_header(header, key));
+	ASSERT_EQ(key.type, (uint32_t) TRACE_KEY_SIGNED);
+	ASSERT_EQ(key.size, sizeof(int));
+	ASSERT_TRUE(key == trace_key<int>());
+	ASSERT_EQ(trace_key<uint64_t>().type, (uint32_t) TRACE_KEY_UNSIGNED);
+	ASSERT_EQ(trace_key<std::string>().type, (uint32_t) TRACE_KEY_STRING);
+	// Trace of other key type isn't read.
+	std::vector<TraceRecord<unsigned int> > unsigned_records;
+	std::stringstream as_unsigned(data);
+	ASSERT_FALSE(read_trace(as_unsigned, unsigned_records));
+	std::vector<TraceRecord<std::string> > string_records;
+	std::stringstream as_string(data);
+	ASSERT_FALSE(read_trace(as_string, string_records));
+	ASSERT_TRUE(string_records.empty());
+}
+
+TEST(AVLTrace, replay) {
+	std::stringstream trace;
+	{
+		TracedAVL<std::string, int> tree(trace);
+		for (int i = 0; i < 100; ++i) {
+			tree.insert(std::to_string(i), i);
+		}
+		for (int i = 0; i < 100; i += 2) {
+			tree.remove(std::to_string(i));
+		}
+		tree.find("1");
+		tree.begin();
+	}
+	std::vector<TraceRecord<std::string> > records;
+	ASSERT_TRUE(read_trace(trace, records));
+	AVL<std::string, int> tree;
+	TraceReport report = replay_trace<int>(records, tree);
+	ASSERT_EQ(report.count[TRACE_INSERT], 100);
+	ASSERT_EQ(report.count[TRACE_REMOVE], 50);
+	ASSERT_EQ(report.count[TRACE_FIND], 1);
+	ASSERT_EQ(report.count[TRACE_ITERATE], 1);
+	ASSERT_EQ(report.count[TRACE_MERGE], 0);
+	ASSERT_LE(report.latency[TRACE_INSERT][TraceReport::P50],
+			report.latency[TRACE_INSERT][TraceReport::MAX]);
+	ASSERT_EQ(tree.size(), 50);
+	ASSERT_NE(tree.find("1"), tree.end());
+	ASSERT_EQ(tree.find("2"), tree.end());
+}
@@ -0,0 +1,473 @@
+/*
+ * AVL_bench.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include <benchmark/benchmark.h>
+#include "AVL.hpp"
+#include "BTree.hpp"
+
+/* Benchmarks of AVL (and BTree engine) against std::map (the baseline),
+ * std::set and sorted vector: insert, find, remove, iteration, merge and copy
+ * construction, for several key types, value sizes, sizes and access patterns.
+ *
+ * Benchmarks are named operation/container/key/value/pattern/size, so they
+ * can be selected by --benchmark_filter. Sizes go from 1e3 up to
+ * AVL_BENCH_MAX_SIZE (environment variable, 1e6 by default, 1e8 at most).
+ * Machine-readable results: --benchmark_out=results.json
+ * --benchmark_out_format=json (see README.md).
+ */
+
+namespace {
+
+/* Value of given size. */
+template<int N>
+struct Payload {
+	char data[N];
+	Payload() {
+		std::fill(data, data + N, 0);
+	}
+};
+
+/* Keys, ordered as their indexes, so sequential pattern inserts ascending
+ * keys. */
+template<typename K>
+K key_at(uint64_t i);
+
+template<>
+int key_at<int>(uint64_t i) {
+	return (int) i;
+}
+
+template<>
+uint64_t key_at<uint64_t>(uint64_t i) {
+	return i * 1000003ULL;
+}
+
+template<>
+std::string key_at<std::string>(uint64_t i) {
+	char buffer[32];
+	std::snprintf(buffer, sizeof(buffer), "key-%016llu", (unsigned long long) i);
+	return buffer;
+}
+
+enum Pattern { SEQUENTIAL, RANDOM, ZIPFIAN };
+const char* const pattern_names[] = { "sequential", "random", "zipfian" };
+
+/* Zipfian generator of indexes in [0, n), with skew theta (as in YCSB,
+ * "Quickly generating billion-record synthetic databases", Gray et al.).
+ * Popular indexes are scattered over the whole range.
+ */
+class Zipfian {
+	uint64_t n;
+	double theta, alpha, zetan, eta;
+
+	static double zeta(uint64_t n, double theta) {
+		double sum = 0;
+		for (uint64_t i = 1; i <= n; ++i) {
+			sum += 1 / std::pow((double) i, theta);
+		}
+		return sum;
+	}
+
+public:
+	Zipfian(uint64_t n, double theta = 0.99) :
+			n(n),
+			theta(theta),
+			alpha(1 / (1 - theta)),
+			zetan(zeta(n, theta)),
+			eta((1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta(2, theta) / zetan)) {}
+
+	template<typename Random>
+	uint64_t operator()(Random& random) {
+		double u = std::uniform_real_distribution<double>(0, 1)(random);
+		double uz = u * zetan;
+		uint64_t rank;
+		if (uz < 1) {
+			rank = 0;
+		} else if (uz < 1 + std::pow(0.5, theta)) {
+			rank = 1;
+		} else {
+			rank = (uint64_t) (n * std::pow(eta * u - eta + 1, alpha));
+		}
+		// 2654435761 is prime, so multiplying by it permutes [0, n).
+		return rank % n * 2654435761ULL % n;
+	}
+};
+
+/* Sequence of n indexes of keys in [0, n), in given pattern. */
+std::vector<uint64_t> indexes(uint64_t n, Pattern pattern) {
+	std::vector<uint64_t> result(n);
+	std::mt19937_64 random(n);
+	if (pattern == ZIPFIAN) {
+		Zipfian zipfian(n);
+		for (uint64_t i = 0; i < n; ++i) {
+			result[i] = zipfian(random);
+		}
+		return result;
+	}
+	for (uint64_t i = 0; i < n; ++i) {
+		result[i] = i;
+	}
+	if (pattern == RANDOM)
+		std::shuffle(result.begin(), result.end(), random);
+	return result;
+}
+
+template<typename K>
+std::vector<K> keys(uint64_t n, Pattern pattern) {
+	std::vector<uint64_t> order = indexes(n, pattern);
+	std::vector<K> result;
+	result.reserve(n);
+	for (uint64_t i = 0; i < n; ++i) {
+		result.push_back(key_at<K>(order[i]));
+	}
+	return result;
+}
+
+/* Containers under test, with a common interface. */
+template<typename K, typename V>
+struct AVLContainer {
+	typedef AVL<K, V> type;
+	static const char* name() {
+		return "AVL";
+	}
+	static void insert(type& c, const K& k, const V& v) {
+		c.insert(k, v);
+	}
+	static bool find(const type& c, const K& k) {
+		return c.find(k) != c.end();
+	}
+	static void remove(type& c, const K& k) {
+		c.remove(k);
+	}
+	static void merge(type& c, const type& other) {
+		c.merge(other);
+	}
+};
+
+template<typename K, typename V>
+struct BTreeContainer {
+	typedef BTree<K, V> type;
+	static const char* name() {
+		return "BTree";
+	}
+	static void insert(type& c, const K& k, const V& v) {
+		c.insert(k, v);
+	}
+	static bool find(const type& c, const K& k) {
+		return c.find(k) != c.end();
+	}
+	static void remove(type& c, const K& k) {
+		c.remove(k);
+	}
+	static void merge(type& c, const type& other) {
+		c.merge(other);
+	}
+};
+
+template<typename K, typename V>
+struct MapContainer {
+	typedef std::map<K, V> type;
+	static const char* name() {
+		return "map";
+	}
+	static void insert(type& c, const K& k, const V& v) {
+		c.insert(std::make_pair(k, v));
+	}
+	static bool find(const type& c, const K& k) {
+		return c.find(k) != c.end();
+	}
+	static void remove(type& c, const K& k) {
+		c.erase(k);
+	}
+	static void merge(type& c, const type& other) {
+		c.insert(other.begin(), other.end());
+	}
+};
+
+/* Keys only, value is ignored. */
+template<typename K, typename V>
+struct SetContainer {
+	typedef std::set<K> type;
+	static const char* name() {
+		return "set";
+	}
+	static void insert(type& c, const K& k, const V&) {
+		c.insert(k);
+	}
+	static bool find(const type& c, const K& k) {
+		return c.find(k) != c.end();
+	}
+	static void remove(type& c, const K& k) {
+		c.erase(k);
+	}
+	static void merge(type& c, const type& other) {
+		c.insert(other.begin(), other.end());
+	}
+};
+
+template<typename K, typename V>
+struct SortedVectorContainer {
+	typedef std::vector<std::pair<K, V> > type;
+	static const char* name() {
+		return "sorted_vector";
+	}
+	static bool key_less(const std::pair<K, V>& item, const K& k) {
+		return item.first < k;
+	}
+	static void insert(type& c, const K& k, const V& v) {
+		typename type::iterator it = std::lower_bound(c.begin(), c.end(), k,
+				key_less);
+		if (it == c.end() || k < it->first)
+			c.insert(it, std::make_pair(k, v));
+	}
+	static bool find(const type& c, const K& k) {
+		typename type::const_iterator it = std::lower_bound(c.begin(), c.end(),
+				k, key_less);
+		return it != c.end() && !(k < it->first);
+	}
+	static void remove(type& c, const K& k) {
+		typename type::iterator it = std::lower_bound(c.begin(), c.end(), k,
+				key_less);
+		if (it != c.end() && !(k < it->first))
+			c.erase(it);
+	}
+	static void merge(type& c, const type& other) {
+		type merged;
+		merged.reserve(c.size() + other.size());
+		std::merge(c.begin(), c.end(), other.begin(), other.end(),
+				std::back_inserter(merged),
+				[](const std::pair<K, V>& a, const std::pair<K, V>& b) {
+					return a.first < b.first;
+				});
+		merged.erase(std::unique(merged.begin(), merged.end(),
+				[](const std::pair<K, V>& a, const std::pair<K, V>& b) {
+					return !(a.first < b.first || b.first < a.first);
+				}), merged.end());
+		c.swap(merged);
+	}
+};
+
+/* Container, to which keys are inserted one by one, in given order. */
+template<typename C, typename K, typename V>
+typename C::type* insert_all(const std::vector<K>& keys) {
+	typename C::type* c = new typename C::type();
+	for (size_t i = 0; i < keys.size(); ++i) {
+		C::insert(*c, keys[i], V());
+	}
+	return c;
+}
+
+/* Builds container of given keys, for benchmarks of other operations. */
+template<typename C, typename K, typename V>
+struct builder {
+	static typename C::type* build(const std::vector<K>& keys) {
+		return insert_all<C, K, V>(keys);
+	}
+};
+
+/* Sorted vector is sorted at once, as inserting one by one is O(n^2). */
+template<typename K, typename V>
+struct builder<SortedVectorContainer<K, V>, K, V> {
+	typedef typename SortedVectorContainer<K, V>::type type;
+	static type* build(const std::vector<K>& keys) {
+		std::vector<K> sorted(keys);
+		std::sort(sorted.begin(), sorted.end());
+		sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+		type* c = new type();
+		c->reserve(sorted.size());
+		for (size_t i = 0; i < sorted.size(); ++i) {
+			c->push_back(std::make_pair(sorted[i], V()));
+		}
+		return c;
+	}
+};
+
+template<typename C, typename K, typename V>
+typename C::type* build(const std::vector<K>& keys) {
+	return builder<C, K, V>::build(keys);
+}
+
+/* Benchmarks. Each processes n items per iteration. Building and freeing of
+ * containers, which aren't measured, is excluded from timing.
+ */
+template<typename C, typename K, typename V>
+void bm_insert(benchmark::State& state, Pattern pattern) {
+	std::vector<K> order = keys<K>(state.range(0), pattern);
+	for (auto _ : state) {
+		typename C::type* c = insert_all<C, K, V>(order);
+		benchmark::DoNotOptimize(c);
+		state.PauseTiming();
+		delete c;
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename C, typename K, typename V>
+void bm_find(benchmark::State& state, Pattern pattern) {
+	typename C::type* c = build<C, K, V>(keys<K>(state.range(0), RANDOM));
+	std::vector<K> order = keys<K>(state.range(0), pattern);
+	for (auto _ : state) {
+		for (size_t i = 0; i < order.size(); ++i) {
+			benchmark::DoNotOptimize(C::find(*c, order[i]));
+		}
+	}
+	delete c;
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename C, typename K, typename V>
+void bm_remove(benchmark::State& state, Pattern pattern) {
+	typename C::type* full = build<C, K, V>(keys<K>(state.range(0), RANDOM));
+	std::vector<K> order = keys<K>(state.range(0), pattern);
+	for (auto _ : state) {
+		state.PauseTiming();
+		typename C::type* c = new typename C::type(*full);
+		state.ResumeTiming();
+		for (size_t i = 0; i < order.size(); ++i) {
+			C::remove(*c, order[i]);
+		}
+		state.PauseTiming();
+		delete c;
+		state.ResumeTiming();
+	}
+	delete full;
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename C, typename K, typename V>
+void bm_iterate(benchmark::State& state) {
+	typename C::type* c = build<C, K, V>(keys<K>(state.range(0), RANDOM));
+	for (auto _ : state) {
+		for (auto it = c->begin(); it != c->end(); ++it) {
+			benchmark::DoNotOptimize(&*it);
+		}
+	}
+	delete c;
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/* Merges two containers of n/2 items each, with interleaved keys. */
+template<typename C, typename K, typename V>
+void bm_merge(benchmark::State& state) {
+	std::vector<K> all = keys<K>(state.range(0), RANDOM);
+	std::vector<K> even, odd;
+	for (size_t i = 0; i < all.size(); ++i) {
+		(i % 2 ? odd : even).push_back(all[i]);
+	}
+	typename C::type* left = build<C, K, V>(even);
+	typename C::type* right = build<C, K, V>(odd);
+	for (auto _ : state) {
+		state.PauseTiming();
+		typename C::type* c = new typename C::type(*left);
+		state.ResumeTiming();
+		C::merge(*c, *right);
+		state.PauseTiming();
+		delete c;
+		state.ResumeTiming();
+	}
+	delete left;
+	delete right;
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename C, typename K, typename V>
+void bm_copy(benchmark::State& state) {
+	typename C::type* source = build<C, K, V>(keys<K>(state.range(0), RANDOM));
+	for (auto _ : state) {
+		typename C::type* c = new typename C::type(*source);
+		benchmark::DoNotOptimize(c);
+		state.PauseTiming();
+		delete c;
+		state.ResumeTiming();
+	}
+	delete source;
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/* Sizes of benchmarks, powers of 10 from 1e3 up to max_size. */
+std::vector<int64_t> sizes;
+
+void apply_sizes(benchmark::internal::Benchmark* b, int64_t limit) {
+	for (size_t i = 0; i < sizes.size() && sizes[i] <= limit; ++i) {
+		b->Arg(sizes[i]);
+	}
+	b->Unit(benchmark::kMicrosecond);
+}
+
+template<typename C, typename K, typename V>
+void register_container(const std::string& suffix) {
+	// Sorted vector inserts and removes in O(n), so it's limited to 1e5.
+	bool quadratic = std::string(C::name()) == "sorted_vector";
+	int64_t limit = quadratic ? 100000 : INT64_MAX;
+	std::string name = std::string(C::name()) + "/" + suffix;
+	for (int p = SEQUENTIAL; p <= ZIPFIAN; ++p) {
+		Pattern pattern = (Pattern) p;
+		std::string pattern_name = pattern_names[p];
+		apply_sizes(benchmark::RegisterBenchmark(
+				("insert/" + name + "/" + pattern_name).c_str(),
+				bm_insert<C, K, V>, pattern), limit);
+		apply_sizes(benchmark::RegisterBenchmark(
+				("find/" + name + "/" + pattern_name).c_str(),
+				bm_find<C, K, V>, pattern), INT64_MAX);
+		apply_sizes(benchmark::RegisterBenchmark(
+				("remove/" + name + "/" + pattern_name).c_str(),
+				bm_remove<C, K, V>, pattern), limit);
+	}
+	apply_sizes(benchmark::RegisterBenchmark(("iterate/" + name).c_str(),
+			bm_iterate<C, K, V>), INT64_MAX);
+	apply_sizes(benchmark::RegisterBenchmark(("merge/" + name).c_str(),
+			bm_merge<C, K, V>), INT64_MAX);
+	apply_sizes(benchmark::RegisterBenchmark(("copy/" + name).c_str(),
+			bm_copy<C, K, V>), INT64_MAX);
+}
+
+template<typename K, typename V>
+void register_all(const std::string& key_name, const std::string& value_name,
+		bool with_set) {
+	std::string suffix = key_name + "/" + value_name;
+	register_container<MapContainer<K, V>, K, V>(suffix);
+	register_container<AVLContainer<K, V>, K, V>(suffix);
+	register_container<BTreeContainer<K, V>, K, V>(suffix);
+	register_container<SortedVectorContainer<K, V>, K, V>(suffix);
+	if (with_set)
+		register_container<SetContainer<K, V>, K, V>(suffix);
+}
+
+}
+
+int main(int argc, char** argv) {
+	int64_t max_size = 1000000;
+	const char* env = std::getenv("AVL_BENCH_MAX_SIZE");
+	if (env)
+		max_size = std::min<int64_t>(std::atoll(env), 100000000);
+	for (int64_t n = 1000; n <= max_size; n *= 10) {
+		sizes.push_back(n);
+	}
+	// Set ignores values, so it's measured with the smallest one only.
+	register_all<int, Payload<8> >("int", "v8", true);
+	register_all<int, Payload<64> >("int", "v64", false);
+	register_all<int, Payload<256> >("int", "v256", false);
+	register_all<uint64_t, Payload<8> >("uint64", "v8", true);
+	register_all<std::string, Payload<8> >("string", "v8", true);
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
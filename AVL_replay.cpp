@@ -0,0 +1,183 @@
+/*
+ * AVL_replay.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <stdint.h>
+#include "AVL.hpp"
+#include "AVLTrace.hpp"
+#include "Dictionary.hpp"
+
+/* Replay driver: runs a trace, recorded by TracedAVL, against tree
+ * configurations, and prints throughput and latency percentiles.
+ *
+ * Usage: AVL_replay <trace file> [int|uint64|string] [configuration...]
+ *     Key type is taken from the trace header, if it's given, it must be the
+ *     recorded one. Configurations are named as in configuration_names, all
+ *     of them are run by default.
+ */
+
+namespace {
+
+/* std::map with AVL interface, as the baseline. */
+template<typename Key, typename Value>
+class MapTree: public std::map<Key, Value> {
+	typedef std::map<Key, Value> Base;
+
+public:
+	bool insert(const Key& k, const Value& v) {
+		return Base::insert(std::make_pair(k, v)).second;
+	}
+	void remove(const Key& k) {
+		Base::erase(k);
+	}
+	void merge(const MapTree& t) {
+		Base::insert(t.begin(), t.end());
+	}
+};
+
+const char* const operation_names[] = { "", "insert", "find", "remove",
+		"merge", "iterate" };
+
+const char* const key_type_names[] = { "int", "uint64", "string" };
+
+/* @Return: name of key type, which keys of trace are read as, NULL if it's
+ *     none of key_type_names.
+ */
+const char* key_type_name(const TraceKey& key) {
+	if (key == trace_key<int>())
+		return "int";
+	if (key == trace_key<uint64_t>())
+		return "uint64";
+	if (key == trace_key<std::string>())
+		return "string";
+	return NULL;
+}
+
+bool is_key_type(const char* name) {
+	for (size_t i = 0; i < sizeof(key_type_names) / sizeof(key_type_names[0]);
+			++i) {
+		if (!std::strcmp(name, key_type_names[i]))
+			return true;
+	}
+	return false;
+}
+
+const char* const configuration_names[] = { "std::map", "AVL",
+		"AVL+CountAugment", "AVL+AncestorStack", "WAVL", "BTree" };
+const int CONFIGURATIONS = sizeof(configuration_names)
+		/ sizeof(configuration_names[0]);
+
+/* Configurations, selected by command line. */
+struct Selection {
+	char** names;
+	int count;
+	bool has(const char* configuration) const {
+		for (int i = 0; i < count; ++i) {
+			if (!std::strcmp(names[i], configuration))
+				return true;
+		}
+		return count == 0;
+	}
+};
+
+void print(const char* configuration, const TraceReport& r) {
+	std::printf("%s: %.3f s, %.0f ops/s\n", configuration, r.seconds,
+			r.ops_per_second);
+	std::printf("    %-8s %10s %10s %10s %10s %10s %10s\n", "op", "count",
+			"p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+	for (int op = TRACE_INSERT; op < TRACE_OPERATIONS; ++op) {
+		if (!r.count[op])
+			continue;
+		std::printf("    %-8s %10lld", operation_names[op],
+				(long long) r.count[op]);
+		for (int p = 0; p < TraceReport::PERCENTILES; ++p) {
+			std::printf(" %10lld", (long long) r.latency[op][p]);
+		}
+		std::printf("\n");
+	}
+}
+
+template<typename Tree, typename Key>
+void run(const char* configuration,
+		const std::vector<TraceRecord<Key> >& records,
+		const Selection& selection) {
+	if (!selection.has(configuration))
+		return;
+	Tree tree;
+	print(configuration, replay_trace<int>(records, tree));
+}
+
+template<typename Key>
+int replay(const char* path, const Selection& selection) {
+	std::ifstream is(path, std::ios::binary);
+	std::vector<TraceRecord<Key> > records;
+	if (!is || !read_trace(is, records)) {
+		std::fprintf(stderr, "%s: not a trace, or it is corrupted\n", path);
+		return 1;
+	}
+	std::printf("%s: %zu records\n", path, records.size());
+	run<MapTree<Key, int> >("std::map", records, selection);
+	run<AVL<Key, int> >("AVL", records, selection);
+	run<AVL<Key, int, CountAugment> >("AVL+CountAugment", records, selection);
+	run<AVL<Key, int, NoAugment, AncestorStack> >("AVL+AncestorStack",
+			records, selection);
+	run<AVL<Key, int, NoAugment, ParentLinks, WAVLBalance> >("WAVL", records,
+			selection);
+	run<Dictionary<Key, int, BTreeEngine> >("BTree", records, selection);
+	return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s <trace file> "
+				"[int|uint64|string] [configuration...]\n", argv[0]);
+		return 2;
+	}
+	const char* given = argc >= 3 && is_key_type(argv[2]) ? argv[2] : NULL;
+	int first = given ? 3 : 2;
+	Selection selection = { argv + first, argc > first ? argc - first : 0 };
+	for (int i = 0; i < selection.count; ++i) {
+		Selection known = { selection.names + i, 1 };
+		int c = 0;
+		while (c < CONFIGURATIONS && !known.has(configuration_names[c])) {
+			++c;
+		}
+		if (c == CONFIGURATIONS) {
+			std::fprintf(stderr, "unknown configuration: %s\n",
+					selection.names[i]);
+			return 2;
+		}
+	}
+	std::ifstream is(argv[1], std::ios::binary);
+	TraceKey header;
+	if (!is || !read_trace_header(is, header)) {
+		std::fprintf(stderr, "%s: not a trace\n", argv[1]);
+		return 1;
+	}
+	const char* key = key_type_name(header);
+	if (!key) {
+		std::fprintf(stderr, "%s: unsupported key type %u of %u bytes\n",
+				argv[1], (unsigned int) header.type,
+				(unsigned int) header.size);
+		return 1;
+	}
+	if (given && std::strcmp(given, key)) {
+		std::fprintf(stderr, "%s: recorded with %s keys, not %s\n", argv[1],
+				key, given);
+		return 1;
+	}
+	if (!std::strcmp(key, "int"))
+		return replay<int>(argv[1], selection);
+	if (!std::strcmp(key, "uint64"))
+		return replay<uint64_t>(argv[1], selection);
+	return replay<std::string>(argv[1], selection);
+}
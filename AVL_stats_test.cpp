@@ -0,0 +1,137 @@
+/*
+ * AVL_stats_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#define AVL_ENABLE_STATS
+#include <gtest/gtest.h>
+#include "AVL.hpp"
+
+namespace {
+/* Key type of this file only, so trees with statistics don't share
+ * instantiations with trees of other tests, built without them. */
+struct StatsKey {
+	int k;
+	StatsKey(int k = 0) : k(k) {}
+	bool operator<(const StatsKey& other) const {
+		return k < other.k;
+	}
+};
+
+typedef AVL<StatsKey, int> StatsTree;
+typedef AVL<StatsKey, int, NoAugment, ParentLinks, WAVLBalance> StatsWAVL;
+
+unsigned long long total_rolls(const AVLStats& s, int op) {
+	unsigned long long total = 0;
+	for (int roll = 0; roll < AVLStats::ROLLS; ++roll) {
+		total += s.rolls[op][roll];
+	}
+	return total;
+}
+}
+
+TEST(AVLStats, rolls_by_operation) {
+	StatsTree::reset_stats();
+	StatsTree tree;
+	for (int i = 0; i < 3; ++i) {
+		tree.insert(i, i);
+	}
+	AVLStats s = StatsTree::stats();
+	ASSERT_EQ(s.operations[AVLStats::INSERT], 3ULL);
+	ASSERT_EQ(s.rolls[AVLStats::INSERT][AVLStats::RR], 1ULL);
+	ASSERT_EQ(total_rolls(s, AVLStats::INSERT), 1ULL);
+	tree.insert(-1, 0);
+	tree.insert(-2, 0);
+	s = StatsTree::stats();
+	ASSERT_EQ(s.rolls[AVLStats::INSERT][AVLStats::LL], 1ULL);
+	StatsTree::reset_stats();
+	tree.insert(-4, 0);
+	tree.insert(-3, 0);
+	s = StatsTree::stats();
+	ASSERT_EQ(s.rolls[AVLStats::INSERT][AVLStats::LR], 1ULL);
+	ASSERT_EQ(total_rolls(s, AVLStats::REMOVE), 0ULL);
+}
+
+TEST(AVLStats, comparisons_and_visited) {
+	StatsTree tree;
+	for (int i = 0; i < 1023; ++i) {
+		tree.insert(i, i);
+	}
+	StatsTree::reset_stats();
+	for (int i = 0; i < 1023; ++i) {
+		ASSERT_NE(tree.find(i), tree.end());
+	}
+	AVLStats s = StatsTree::stats();
+	ASSERT_EQ(s.operations[AVLStats::FIND], 1023ULL);
+	// Path to each key is at most height + 1 nodes, at least 1.
+	ASSERT_GE(s.visited[AVLStats::FIND], 1023ULL);
+	ASSERT_LE(s.visited[AVLStats::FIND], 1023ULL * 15);
+	ASSERT_GE(s.comparisons[AVLStats::FIND], s.visited[AVLStats::FIND]);
+	ASSERT_EQ(s.comparisons[AVLStats::INSERT], 0ULL);
+	ASSERT_EQ(s.allocations, 0ULL);
+}
+
+TEST(AVLStats, allocations_and_frees) {
+	StatsTree::reset_stats();
+	{
+		StatsTree tree;
+		for (int i = 0; i < 100; ++i) {
+			tree.insert(i, i);
+		}
+		tree.insert(5, 5); // present, nothing allocated
+		for (int i = 0; i < 100; i += 2) {
+			tree.remove(i);
+		}
+		AVLStats s = StatsTree::stats();
+		ASSERT_EQ(s.allocations, 100ULL);
+		ASSERT_EQ(s.frees, 50ULL);
+		ASSERT_EQ(s.operations[AVLStats::REMOVE], 50ULL);
+		ASSERT_GT(s.visited[AVLStats::REMOVE], 0ULL);
+	}
+	ASSERT_EQ(StatsTree::stats().frees, 100ULL);
+}
+
+TEST(AVLStats, nested_operation_counted_once) {
+	StatsTree tree;
+	tree.insert(1, 1);
+	StatsTree::reset_stats();
+	StatsTree::node_handle h = tree.extract(tree.find(1));
+	AVLStats s = StatsTree::stats();
+	ASSERT_EQ(s.operations[AVLStats::REMOVE], 1ULL);
+	ASSERT_EQ(s.operations[AVLStats::FIND], 1ULL);
+}
+
+TEST(AVLStats, depth_histogram) {
+	StatsTree tree;
+	ASSERT_TRUE(tree.depth_histogram().empty());
+	for (int i = 0; i < 7; ++i) {
+		tree.insert(i, i);
+	}
+	std::vector<int> histogram = tree.depth_histogram();
+	ASSERT_EQ(histogram, std::vector<int>({ 1, 2, 4 }));
+}
+
+/* Removal of each key: AVL rolls at many levels, WAVL at most twice. */
+TEST(AVLStats, wavl_removal_rolls) {
+	StatsTree avl;
+	StatsWAVL wavl;
+	for (int i = 0; i < 4096; ++i) {
+		avl.insert(i * 37 % 4096, i);
+		wavl.insert(i * 37 % 4096, i);
+	}
+	// Insertions only - same AVL shape.
+	ASSERT_EQ(avl.depth_histogram(), wavl.depth_histogram());
+	unsigned long long avl_rolls = 0;
+	for (int i = 0; i < 4096; i += 2) {
+		StatsWAVL::reset_stats();
+		StatsTree::reset_stats();
+		wavl.remove(i * 11 % 4096);
+		avl.remove(i * 11 % 4096);
+		ASSERT_LE(total_rolls(StatsWAVL::stats(), AVLStats::REMOVE), 2ULL);
+		avl_rolls += total_rolls(StatsTree::stats(), AVLStats::REMOVE);
+	}
+	ASSERT_GT(avl_rolls, 0ULL);
+	// Height stays logarithmic.
+	ASSERT_LE(wavl.depth_histogram().size(), 2 * 11U);
+}
@@ -5,6 +5,12 @@
  *      Author: Lev Pechersky
  */
 #include <vector>
+#include <limits>
+#include <map>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <algorithm>
 #include <gtest/gtest.h>
 #include "AVL.hpp"
@@ -531,3 +537,759 @@ TEST(AVL_Tree, insert_all_delete_all) {
 	}
 	ASSERT_TRUE(tree.empty());
 }
+
+/* Small deterministic generator, so failures are reproducible */
+static unsigned int next_random(unsigned int& seed) {
+	seed = seed * 1103515245 + 12345;
+	return (seed / 65536) % 32768;
+}
+
+/* Concatenation of keys - non commutative monoid, checks operands order */
+struct Concat_augment {
+	typedef std::string value_type;
+	static std::string identity() {
+		return "";
+	}
+	static std::string lift(const char& k, const int&) {
+		return std::string(1, k);
+	}
+	static std::string combine(const std::string& a, const std::string& b) {
+		return a + b;
+	}
+};
+
+TEST(AVL_Tree, augment_sum_range) {
+	AVL<int, int, SumAugment<long> > tree;
+	std::vector<int> k = { 41, 3, 5, 15, 25, 31, 32, 40, 45, 38, 33, 43, 13 };
+	for (auto x : k) {
+		tree.insert(x, x);
+	}
+	ASSERT_EQ(tree.aggregate(), 364);
+	ASSERT_EQ(tree.aggregate(5, 32), 5 + 13 + 15 + 25 + 31);
+	ASSERT_EQ(tree.aggregate(4, 6), 5);
+	ASSERT_EQ(tree.aggregate(6, 13), 0);
+	ASSERT_EQ(tree.aggregate(46, 100), 0);
+	ASSERT_EQ(tree.aggregate(32, 5), 0);
+}
+
+TEST(AVL_Tree, augment_empty_tree) {
+	AVL<int, int, SumAugment<int> > tree;
+	ASSERT_EQ(tree.aggregate(), 0);
+	ASSERT_EQ(tree.aggregate(0, 10), 0);
+}
+
+TEST(AVL_Tree, augment_min_max_count) {
+	AVL<int, int, MinAugment<int> > min_tree;
+	AVL<int, int, MaxAugment<int> > max_tree;
+	AVL<int, int, CountAugment> count_tree;
+	std::vector<int> k = { 5, 2, 7, 6, 9, 1, 4, 3, 16, 15 };
+	for (auto x : k) {
+		min_tree.insert(x, -x);
+		max_tree.insert(x, -x);
+		count_tree.insert(x, -x);
+	}
+	ASSERT_EQ(min_tree.aggregate(2, 7), -6);
+	ASSERT_EQ(max_tree.aggregate(2, 7), -2);
+	ASSERT_EQ(count_tree.aggregate(2, 7), 5);
+	ASSERT_EQ(count_tree.aggregate(), 10);
+	ASSERT_EQ(min_tree.aggregate(10, 15), std::numeric_limits<int>::max());
+}
+
+TEST(AVL_Tree, augment_keeps_in_order) {
+	AVL<char, int, Concat_augment> tree;
+	std::string letters = "qwertyuiopasdfghjklzxcvbnm";
+	for (auto c : letters) {
+		tree.insert(c, 0);
+	}
+	tree.remove('k');
+	tree.remove('q');
+	ASSERT_EQ(tree.aggregate(), "abcdefghijlmnoprstuvwxyz");
+	ASSERT_EQ(tree.aggregate('c', 'p'), "cdefghijlmno");
+}
+
+TEST(AVL_Tree, augment_random_insert_remove_merge) {
+	AVL<int, int, SumAugment<long> > tree, other;
+	std::map<int, int> reference;
+	unsigned int seed = 7;
+	for (int i = 0; i < 2000; ++i) {
+		int k = next_random(seed) % 500;
+		if (next_random(seed) % 3) {
+			if (tree.insert(k, k * 3))
+				reference.insert(std::make_pair(k, k * 3));
+		} else {
+			tree.remove(k);
+			reference.erase(k);
+		}
+		if (i == 1000) {
+			for (int j = 1000; j < 1100; ++j) {
+				other.insert(j, 1);
+				reference.insert(std::make_pair(j, 1));
+			}
+			tree.merge(other);
+		}
+		int lo = next_random(seed) % 600, hi = next_random(seed) % 600;
+		long expected = 0;
+		for (auto it = reference.lower_bound(lo);
+				it != reference.end() && it->first < hi; ++it) {
+			expected += it->second;
+		}
+		ASSERT_EQ(tree.aggregate(lo, hi), expected);
+	}
+}
+
+TEST(AVL_Tree, merge_same_keys_left_wins) {
+	AVL<int, int> tree1, tree2;
+	tree1.insert(1, 10);
+	tree1.insert(2, 20);
+	tree2.insert(2, 21);
+	tree2.insert(3, 31);
+	tree1.merge(tree2);
+	ASSERT_EQ(tree1.size(), 3);
+	ASSERT_EQ(*tree1.find(2), 20);
+}
+
+TEST(AVL_Tree, lower_and_upper_bound) {
+	AVL<int, int> tree;
+	std::vector<int> k = { 10, 20, 30, 40 };
+	for (auto x : k) {
+		tree.insert(x, x);
+	}
+	ASSERT_EQ(tree.lower_bound(20).key(), 20);
+	ASSERT_EQ(tree.upper_bound(20).key(), 30);
+	ASSERT_EQ(tree.lower_bound(21).key(), 30);
+	ASSERT_EQ(tree.lower_bound(5).key(), 10);
+	ASSERT_EQ(tree.lower_bound(41), tree.end());
+	ASSERT_EQ(tree.upper_bound(40), tree.end());
+}
+
+TEST(AVL_Tree, erase_range) {
+	AVL<int, int> tree;
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i, i);
+	}
+	ASSERT_EQ(tree.erase_range(10, 20), 10);
+	ASSERT_EQ(tree.erase_range(10, 20), 0);
+	ASSERT_EQ(tree.erase_range(50, 40), 0);
+	ASSERT_EQ(tree.size(), 90);
+	ASSERT_EQ(tree.find(9).key(), 9);
+	ASSERT_EQ(tree.find(10), tree.end());
+	ASSERT_EQ(tree.find(19), tree.end());
+	ASSERT_EQ(tree.find(20).key(), 20);
+	ASSERT_EQ(tree.erase_range(-5, 1000), 90);
+	ASSERT_TRUE(tree.empty());
+}
+
+TEST(AVL_Tree, extract_range) {
+	AVL<int, int, SumAugment<int> > tree;
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i, i);
+	}
+	AVL<int, int, SumAugment<int> > extracted = tree.extract_range(90, 95);
+	ASSERT_EQ(extracted.size(), 5);
+	ASSERT_EQ(extracted.aggregate(), 90 + 91 + 92 + 93 + 94);
+	ASSERT_EQ(tree.aggregate(), 99 * 100 / 2 - extracted.aggregate());
+	int expected = 90;
+	for (auto it = extracted.begin(); it != extracted.end(); ++it) {
+		ASSERT_EQ(it.key(), expected++);
+	}
+	ASSERT_EQ(tree.find(92), tree.end());
+	ASSERT_TRUE(tree.insert(92, 92));
+}
+
+TEST(AVL_Tree, erase_range_random) {
+	AVL<int, int> tree;
+	std::map<int, int> reference;
+	unsigned int seed = 5;
+	for (int i = 0; i < 500; ++i) {
+		for (int j = 0; j < 20; ++j) {
+			int k = next_random(seed) % 2000;
+			tree.insert(k, k);
+			reference.insert(std::make_pair(k, k));
+		}
+		int lo = next_random(seed) % 2000, hi = lo + next_random(seed) % 50;
+		int expected = 0;
+		while (reference.lower_bound(lo) != reference.end()
+				&& reference.lower_bound(lo)->first < hi) {
+			reference.erase(reference.lower_bound(lo));
+			++expected;
+		}
+		ASSERT_EQ(tree.erase_range(lo, hi), expected);
+	}
+	auto expected = reference.begin();
+	for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+		ASSERT_EQ(it.key(), expected->first);
+	}
+	ASSERT_EQ(expected, reference.end());
+}
+
+TEST(AVL_Tree, extract_and_reinsert_node) {
+	AVL<key_type, value_type> tree1, tree2;
+	std::vector<key_type> k = { 41, 3, 5, 15, 25, 31, 32, 40, 45, 38, 33, 43, 13 };
+	std::vector<value_type> v = convert(k);
+	for (unsigned int i = 0; i < k.size(); ++i) {
+		tree1.insert(k[i], v[i]);
+	}
+	for (auto x : k) {
+		AVL<key_type, value_type>::node_handle h = tree1.extract(x);
+		ASSERT_FALSE(h.empty());
+		ASSERT_EQ(h.key(), x);
+		ASSERT_EQ(h.value().x, x.x);
+		ASSERT_TRUE(tree2.insert(std::move(h)));
+		ASSERT_TRUE(h.empty());
+	}
+	ASSERT_TRUE(tree1.empty());
+	auto it = tree2.begin();
+	std::sort(k.begin(), k.end());
+	for (auto x : k) {
+		ASSERT_EQ(it.key(), x);
+		ASSERT_EQ((*it).x, x.x);
+		++it;
+	}
+}
+
+TEST(AVL_Tree, extract_missing_key) {
+	AVL<key_type, value_type> tree;
+	tree.insert(key_type(1), value_type(1));
+	ASSERT_TRUE(tree.extract(key_type(2)).empty());
+	ASSERT_EQ(tree.size(), 1);
+}
+
+TEST(AVL_Tree, extract_by_iterator_and_rekey) {
+	AVL<int, int, SumAugment<int> > tree;
+	for (int i = 0; i < 10; ++i) {
+		tree.insert(i, i);
+	}
+	auto h = tree.extract(tree.find(4));
+	h.key() = 40;
+	ASSERT_TRUE(tree.insert(std::move(h)));
+	ASSERT_EQ(tree.find(4), tree.end());
+	ASSERT_EQ(*tree.find(40), 4);
+	ASSERT_EQ(tree.aggregate(10, 100), 4);
+}
+
+TEST(AVL_Tree, reinsert_existing_key_keeps_handle) {
+	AVL<int, int> tree;
+	tree.insert(1, 1);
+	tree.insert(2, 2);
+	auto h = tree.extract(2);
+	tree.insert(2, 20);
+	ASSERT_FALSE(tree.insert(std::move(h)));
+	ASSERT_FALSE(h.empty());
+	ASSERT_EQ(h.value(), 2);
+}
+
+TEST(AVL_Tree, save_load_roundtrip) {
+	AVL<int, std::string, CountAugment> tree, loaded;
+	for (int i = 0; i < 1000; ++i) {
+		tree.insert(i * 7 % 1000, std::string(i % 13, 'a' + i % 26));
+	}
+	loaded.insert(-1, "will be replaced");
+	std::stringstream stream;
+	ASSERT_TRUE(tree.save(stream));
+	ASSERT_TRUE(loaded.load(stream));
+	ASSERT_EQ(loaded.aggregate(), 1000);
+	auto it = loaded.begin();
+	for (auto j = tree.begin(); j != tree.end(); ++j, ++it) {
+		ASSERT_EQ(it.key(), j.key());
+		ASSERT_EQ(*it, *j);
+	}
+	ASSERT_EQ(it, loaded.end());
+}
+
+TEST(AVL_Tree, save_load_empty) {
+	AVL<int, int> tree, loaded;
+	std::stringstream stream;
+	ASSERT_TRUE(tree.save(stream));
+	loaded.insert(1, 1);
+	ASSERT_TRUE(loaded.load(stream));
+	ASSERT_TRUE(loaded.empty());
+}
+
+TEST(AVL_Tree, load_rejects_bad_input) {
+	AVL<int64_t, int64_t> tree, loaded;
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i, -i);
+	}
+	loaded.insert(5, 5);
+	std::stringstream stream;
+	tree.save(stream);
+	std::string data = stream.str();
+	std::stringstream truncated(data.substr(0, data.size() - 3));
+	ASSERT_FALSE(loaded.load(truncated));
+	std::stringstream garbage("not a snapshot at all");
+	ASSERT_FALSE(loaded.load(garbage));
+	ASSERT_EQ(loaded.size(), 1);
+	ASSERT_EQ(*loaded.find(5), 5);
+}
+
+TEST(AVL_Tree, assign_sorted) {
+	std::vector<std::pair<int, value_type> > items;
+	for (int i = 0; i < 100; ++i) {
+		items.push_back(std::make_pair(i * 2, value_type(i)));
+	}
+	AVL<int, value_type> tree;
+	tree.insert(1, value_type(1));
+	tree.assign_sorted(items.begin(), items.end());
+	ASSERT_EQ(tree.size(), 100);
+	ASSERT_EQ(tree.find(1), tree.end());
+	ASSERT_EQ((*tree.find(60)).x, 30);
+	int expected = 0;
+	for (auto it = tree.begin(); it != tree.end(); ++it, expected += 2) {
+		ASSERT_EQ(it.key(), expected);
+	}
+}
+
+TEST(AVL_Tree, compact_keeps_contents) {
+	CompactOrder orders[] = { COMPACT_INORDER, COMPACT_VEB };
+	for (int o = 0; o < 2; ++o) {
+		AVL<int, std::string> tree;
+		std::map<int, std::string> reference;
+		unsigned int seed = 7;
+		for (int i = 0; i < 2000; ++i) {
+			int k = next_random(seed) % 1000;
+			if (next_random(seed) % 3) {
+				tree.insert(k, std::to_string(k));
+				reference.insert(std::make_pair(k, std::to_string(k)));
+			} else {
+				tree.remove(k);
+				reference.erase(k);
+			}
+		}
+		tree.compact(orders[o]);
+		ASSERT_EQ(tree.size(), (int) reference.size());
+		auto expected = reference.begin();
+		for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+			ASSERT_EQ(it.key(), expected->first);
+			ASSERT_EQ(*it, expected->second);
+		}
+		// Compacted nodes are freed one by one, and mixed with new ones.
+		for (int i = 0; i < 1000; ++i) {
+			tree.remove(i * 7 % 1000);
+			reference.erase(i * 7 % 1000);
+			if (i % 3 == 0) {
+				tree.insert(i, "new");
+				reference.insert(std::make_pair(i, "new"));
+			}
+		}
+		tree.compact(orders[1 - o]);
+		ASSERT_EQ(tree.size(), (int) reference.size());
+		expected = reference.begin();
+		for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+			ASSERT_EQ(it.key(), expected->first);
+			ASSERT_EQ(*it, expected->second);
+		}
+	}
+}
+
+TEST(AVL_Tree, compact_inorder_is_contiguous) {
+	AVL<int, int> tree;
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i * 37 % 100, i);
+	}
+	tree.compact();
+	const int* previous = NULL;
+	for (auto it = tree.begin(); it != tree.end(); ++it) {
+		if (previous) {
+			ASSERT_EQ(&*it, previous + 1);
+		}
+		previous = &*it;
+	}
+}
+
+TEST(AVL_Tree, compacted_nodes_outlive_tree) {
+	AVL<int, std::string> range;
+	AVL<int, std::string>::node_handle h;
+	{
+		AVL<int, std::string> tree;
+		for (int i = 0; i < 50; ++i) {
+			tree.insert(i, std::to_string(i));
+		}
+		tree.compact(COMPACT_VEB);
+		h = tree.extract(10);
+		range = tree.extract_range(20, 30);
+	}
+	ASSERT_EQ(h.value(), "10");
+	ASSERT_EQ(range.size(), 10);
+	ASSERT_EQ(*range.find(25), "25");
+	range.remove(25);
+	AVL<int, std::string> other;
+	ASSERT_TRUE(other.insert(std::move(h)));
+	ASSERT_EQ(*other.find(10), "10");
+}
+
+TEST(AVL_Tree, compacted_chunks_freed_by_threads) {
+	AVL<int, int> tree;
+	for (int i = 0; i < 100000; ++i) { // many chunks
+		tree.insert(i, i);
+	}
+	tree.compact();
+	AVL<int, int> odd;
+	for (int i = 1; i < 100000; i += 2) {
+		ASSERT_TRUE(odd.insert(tree.extract(i)));
+	}
+	// Both trees hold nodes of same chunks, and free them concurrently.
+	std::thread other([&odd]() {
+		for (int i = 1; i < 100000; i += 6) {
+			odd.remove(i);
+		}
+		odd.clear();
+	});
+	tree.clear();
+	other.join();
+	ASSERT_TRUE(odd.empty());
+}
+
+/* Key, whose copy throws when countdown reaches 0 (its move is a copy). */
+struct Throwing_key {
+	static int countdown;
+	int x;
+	Throwing_key(int x) : x(x) {}
+	Throwing_key(const Throwing_key& k) : x(k.x) {
+		if (countdown >= 0 && countdown-- == 0)
+			throw std::runtime_error("copy of key");
+	}
+	bool operator<(const Throwing_key& k) const {
+		return x < k.x;
+	}
+};
+int Throwing_key::countdown = -1;
+
+TEST(AVL_Tree, compact_is_undone_if_copy_throws) {
+	AVL<Throwing_key, std::string> tree;
+	for (int i = 0; i < 5000; ++i) { // many chunks
+		tree.insert(Throwing_key(i * 7 % 5000), std::to_string(i * 7 % 5000));
+	}
+	tree.compact();
+	int counts[] = { 0, 3000, 4999 };
+	for (int c = 0; c < 3; ++c) {
+		Throwing_key::countdown = counts[c];
+		ASSERT_THROW(tree.compact(COMPACT_VEB), std::runtime_error);
+		Throwing_key::countdown = -1;
+		ASSERT_EQ(tree.size(), 5000);
+		int expected = 0;
+		for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+			ASSERT_EQ(it.key().x, expected);
+			ASSERT_EQ(*it, std::to_string(expected));
+		}
+	}
+	tree.compact(COMPACT_VEB);
+	ASSERT_EQ(*tree.find(Throwing_key(1234)), "1234");
+}
+
+TEST(AVL_Tree, memory_usage) {
+	AVL<int, int> tree;
+	AVLMemoryUsage usage = tree.memory_usage();
+	ASSERT_EQ(usage.total(), 0U);
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i, i);
+	}
+	usage = tree.memory_usage();
+	ASSERT_EQ(usage.values, 100 * sizeof(int));
+	ASSERT_GE(usage.nodes, 100 * (sizeof(int) + 3 * sizeof(void*)));
+	ASSERT_GT(usage.slack, 0U); // separately allocated
+	tree.compact();
+	AVLMemoryUsage compacted = tree.memory_usage();
+	ASSERT_EQ(compacted.nodes, usage.nodes);
+	ASSERT_EQ(compacted.values, usage.values);
+	ASSERT_EQ(compacted.slack, 0U);
+	for (int i = 0; i < 100; i += 2) {
+		tree.remove(i);
+	}
+	ASSERT_GT(tree.memory_usage().slack, 0U); // freed slots of slabs
+}
+
+/* Tree without parent links, iterators keep the ancestors instead */
+typedef AVL<int, int, NoAugment, AncestorStack> StackAVL;
+
+static void expect_same(const StackAVL& tree,
+		const std::map<int, int>& reference) {
+	ASSERT_EQ(tree.size(), (int) reference.size());
+	auto expected = reference.begin();
+	for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+		ASSERT_EQ(it.key(), expected->first);
+		ASSERT_EQ(*it, expected->second);
+	}
+	ASSERT_EQ(expected, reference.end());
+}
+
+TEST(AVL_Tree, ancestor_stack_random_against_map) {
+	StackAVL tree;
+	std::map<int, int> reference;
+	unsigned int seed = 11;
+	for (int i = 0; i < 20000; ++i) {
+		int k = next_random(seed) % 1000;
+		if (next_random(seed) % 3) {
+			bool inserted = reference.insert(std::make_pair(k, i)).second;
+			ASSERT_EQ(tree.insert(k, i), inserted);
+		} else {
+			reference.erase(k);
+			tree.remove(k);
+		}
+		if (i % 1000 == 0)
+			expect_same(tree, reference);
+	}
+	expect_same(tree, reference);
+	for (int k = 0; k < 1000; k += 7) {
+		// Iterators from searches keep going to the end
+		auto expected = reference.lower_bound(k);
+		for (auto it = tree.lower_bound(k); it != tree.end(); ++it, ++expected) {
+			ASSERT_EQ(it.key(), expected->first);
+		}
+		ASSERT_EQ(expected, reference.end());
+		expected = reference.upper_bound(k);
+		for (auto it = tree.upper_bound(k); it != tree.end(); ++it, ++expected) {
+			ASSERT_EQ(it.key(), expected->first);
+		}
+		ASSERT_EQ(expected, reference.end());
+		expected = reference.find(k);
+		auto it = tree.find(k);
+		ASSERT_EQ(it == tree.end(), expected == reference.end());
+		for (; it != tree.end(); ++it, ++expected) {
+			ASSERT_EQ(it.key(), expected->first);
+		}
+	}
+}
+
+TEST(AVL_Tree, ancestor_stack_ranges_and_rebuilds) {
+	StackAVL tree, other;
+	std::map<int, int> reference;
+	for (int i = 0; i < 300; ++i) {
+		tree.insert(i * 7 % 300, i);
+		reference[i * 7 % 300] = i;
+	}
+	ASSERT_EQ(tree.erase_range(10, 20), 10);
+	reference.erase(reference.find(10), reference.find(20));
+	StackAVL extracted = tree.extract_range(100, 150);
+	ASSERT_EQ(extracted.size(), 50);
+	reference.erase(reference.find(100), reference.find(150));
+	expect_same(tree, reference);
+	for (int i = 250; i < 400; ++i) {
+		other.insert(i, -i);
+		reference.insert(std::make_pair(i, -i));
+	}
+	tree.merge(other);
+	expect_same(tree, reference);
+	tree.compact(COMPACT_VEB);
+	expect_same(tree, reference);
+	StackAVL::node_handle h = tree.extract(tree.find(5));
+	reference.erase(5);
+	h.key() = 1000;
+	reference[1000] = h.value();
+	ASSERT_TRUE(tree.insert(std::move(h)));
+	expect_same(tree, reference);
+	StackAVL copy(tree);
+	expect_same(copy, reference);
+}
+
+TEST(AVL_Tree, ancestor_stack_extract_iterator) {
+	StackAVL tree;
+	std::map<int, int> reference;
+	for (int i = 0; i < 500; ++i) {
+		tree.insert(i, i);
+		reference[i] = i;
+	}
+	unsigned int seed = 5;
+	while (!reference.empty()) {
+		// Iterator reached by traversal, its path is kept by ++
+		int skip = next_random(seed) % reference.size();
+		auto it = tree.begin();
+		for (int i = 0; i < skip; ++i) {
+			++it;
+		}
+		int k = it.key();
+		StackAVL::node_handle h = tree.extract(it);
+		ASSERT_EQ(h.key(), k);
+		reference.erase(k);
+		if (reference.size() % 50 == 0)
+			expect_same(tree, reference);
+	}
+	ASSERT_EQ(tree.begin(), tree.end());
+}
+
+TEST(AVL_Tree, ancestor_stack_smaller_nodes) {
+	AVL<int, int> linked;
+	StackAVL stacked;
+	for (int i = 0; i < 100; ++i) {
+		linked.insert(i, i);
+		stacked.insert(i, i);
+	}
+	ASSERT_EQ(linked.memory_usage().nodes - stacked.memory_usage().nodes,
+			100 * sizeof(void*));
+}
+
+/* Weak AVL balancing: removals keep ranks, which aren't heights */
+typedef AVL<int, int, CountAugment, ParentLinks, WAVLBalance> WAVLTree;
+
+/* Checks rank rules of the whole tree */
+struct CheckedWAVL: WAVLTree {
+	bool ranks_valid() const {
+		return ranks_valid_r(root);
+	}
+	static bool ranks_valid_r(Node* r) {
+		if (!r)
+			return true;
+		int left_diff = r->height - rank(r->left);
+		int right_diff = r->height - rank(r->right);
+		if (left_diff < 1 || left_diff > 2 || right_diff < 1 || right_diff > 2)
+			return false;
+		if (is_leaf(r) && r->height != 0)
+			return false;
+		return ranks_valid_r(r->left) && ranks_valid_r(r->right);
+	}
+	CheckedWAVL copy(unsigned threads) const {
+		CheckedWAVL c;
+		c.root = copy_r(root, threads);
+		return c;
+	}
+	bool same_shape(const CheckedWAVL& t) const {
+		return same_shape_r(root, t.root);
+	}
+	static bool same_shape_r(Node* a, Node* b) {
+		if (!a || !b)
+			return a == b;
+		return a != b && a->key == b->key && *(a->value) == *(b->value)
+				&& a->height == b->height && a->aggregate == b->aggregate
+				&& same_shape_r(a->left, b->left)
+				&& same_shape_r(a->right, b->right);
+	}
+};
+
+TEST(AVL_Tree, wavl_random_against_map) {
+	CheckedWAVL tree;
+	std::map<int, int> reference;
+	unsigned int seed = 13;
+	for (int i = 0; i < 30000; ++i) {
+		int k = next_random(seed) % 2000;
+		if (next_random(seed) % 2) {
+			bool inserted = reference.insert(std::make_pair(k, i)).second;
+			ASSERT_EQ(tree.insert(k, i), inserted);
+		} else {
+			reference.erase(k);
+			tree.remove(k);
+		}
+		if (i % 1000 == 0) {
+			ASSERT_TRUE(tree.ranks_valid());
+			int lo = next_random(seed) % 2000, hi = lo + next_random(seed) % 100;
+			std::map<int, int>::iterator first = reference.lower_bound(lo);
+			std::map<int, int>::iterator last = reference.lower_bound(hi);
+			int expected = std::distance(first, last);
+			ASSERT_EQ(tree.aggregate(lo, hi), expected);
+			if (next_random(seed) % 2) {
+				ASSERT_EQ(tree.erase_range(lo, hi), expected);
+			} else {
+				ASSERT_EQ(tree.extract_range(lo, hi).size(), expected);
+			}
+			reference.erase(first, last);
+		}
+	}
+	ASSERT_EQ(tree.aggregate(), (int) reference.size());
+	WAVLTree other;
+	for (int i = 1500; i < 2500; ++i) {
+		other.insert(i, -i);
+		reference.insert(std::make_pair(i, -i));
+	}
+	tree.merge(other);
+	for (int i = 0; i < 2500; i += 3) {
+		tree.remove(i);
+		reference.erase(i);
+	}
+	ASSERT_TRUE(tree.ranks_valid());
+	auto expected = reference.begin();
+	for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+		ASSERT_EQ(it.key(), expected->first);
+		ASSERT_EQ(*it, expected->second);
+	}
+	ASSERT_EQ(expected, reference.end());
+	ASSERT_EQ(tree.aggregate(), (int) reference.size());
+}
+
+TEST(AVL_Tree, wavl_remove_all) {
+	AVL<int, int, NoAugment, AncestorStack, WAVLBalance> tree;
+	for (int i = 0; i < 1000; ++i) {
+		tree.insert(i * 7 % 1000, i);
+	}
+	for (int i = 0; i < 1000; ++i) {
+		tree.remove(i * 13 % 1000);
+		if (i % 100 == 0) {
+			int count = 0;
+			for (auto it = tree.begin(); it != tree.end(); ++it) {
+				++count;
+			}
+			ASSERT_EQ(count, 999 - i);
+		}
+	}
+	ASSERT_TRUE(tree.empty());
+}
+
+TEST(AVL_Tree, build_parallel) {
+	std::vector<std::pair<int, std::string> > items;
+	std::map<int, std::string> reference;
+	unsigned int seed = 17;
+	for (int i = 0; i < 100000; ++i) {
+		int k = next_random(seed) * 4 + next_random(seed) % 4;
+		items.push_back(std::make_pair(k, std::to_string(i)));
+		reference.insert(items.back()); // first of equal keys is taken
+	}
+	for (unsigned threads = 1; threads <= 5; threads += 2) {
+		AVL<int, std::string, CountAugment> tree(-1, "old");
+		tree.build_parallel(items.begin(), items.end(), threads);
+		ASSERT_EQ(tree.aggregate(), (int) reference.size());
+		auto expected = reference.begin();
+		for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+			ASSERT_EQ(it.key(), expected->first);
+			ASSERT_EQ(*it, expected->second);
+		}
+		ASSERT_EQ(expected, reference.end());
+		tree.insert(-1, "new");
+		ASSERT_EQ(*tree.find(-1), "new");
+	}
+	AVL<int, std::string> tree(1, "one");
+	tree.build_parallel(items.end(), items.end());
+	ASSERT_TRUE(tree.empty());
+}
+
+TEST(AVL_Tree, copy_keeps_shape) {
+	CheckedWAVL tree;
+	unsigned int seed = 19;
+	for (int i = 0; i < 200000; ++i) {
+		tree.insert(next_random(seed) * 32768 + next_random(seed), i);
+	}
+	for (int i = 0; i < 50000; ++i) {
+		tree.remove(next_random(seed) * 32768 + next_random(seed));
+	}
+	for (unsigned threads = 1; threads <= 4; threads *= 4) {
+		CheckedWAVL copy = tree.copy(threads);
+		ASSERT_TRUE(copy.same_shape(tree));
+		ASSERT_TRUE(copy.ranks_valid());
+	}
+	WAVLTree copy(tree);
+	ASSERT_EQ(copy.aggregate(), tree.aggregate());
+	copy = WAVLTree();
+	copy = tree;
+	ASSERT_EQ(copy.aggregate(), tree.aggregate());
+	copy.clear();
+	ASSERT_NE(tree.begin(), tree.end());
+}
+
+TEST(AVL_Tree, branchless_search_keys) {
+	AVL<int, int> ints;
+	int k[] = { std::numeric_limits<int>::min(), -5, 0, 7,
+			std::numeric_limits<int>::max() };
+	for (int i = 0; i < 5; ++i) {
+		ints.insert(k[i], i);
+	}
+	for (int i = 0; i < 5; ++i) {
+		ASSERT_EQ(*ints.find(k[i]), i);
+		ASSERT_FALSE(ints.insert(k[i], -1));
+	}
+	ASSERT_EQ(ints.find(-4), ints.end());
+	ASSERT_EQ(ints.find(std::numeric_limits<int>::max() - 1), ints.end());
+	AVL<double, int> doubles;
+	for (int i = 0; i < 100; ++i) {
+		doubles.insert(i / 4.0, i);
+	}
+	ASSERT_EQ(*doubles.find(2.25), 9);
+	ASSERT_EQ(doubles.find(2.3), doubles.end());
+	doubles.clear();
+	ASSERT_EQ(doubles.find(1.0), doubles.end());
+}
@@ -0,0 +1,693 @@
+/*
+ * BTree.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef BTREE_HPP_
+#define BTREE_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace aux {
+/* Default number of keys in B-tree node: keys of a node take 4 cache lines,
+ * but there are 8 to 64 of them. */
+template<typename Key>
+struct btree_keys {
+	enum {
+		fit = 256 / sizeof(Key),
+		value = fit < 8 ? 8 : (fit > 64 ? 64 : fit)
+	};
+};
+}
+
+/* B+ tree, ordered dictionary with the same public API as AVL (see
+ * Dictionary.hpp to switch between them). Each node stores up to MaxKeys
+ * keys contiguously, so a lookup takes about log(n)/log(MaxKeys) cache
+ * misses instead of log(n). Items are stored in leaves, which are linked
+ * for in-order iteration. Values are stored by pointer, as in AVL.
+ *
+ * @Iterators and references invalidation:
+ * All iterators are invalidated after each operation, that changes the tree.
+ * References to values are valid until their item is removed, or the tree
+ * is merged into (as in AVL).
+ *
+ * @Requirements from Key: has operator< implemented, copy-constructible,
+ *     assignable, default-constructible.
+ * @Requirements from Value: Copy-constructible.
+ *
+ * For each function, if not defined otherwise, n is number of items in tree,
+ * and memory complexity is O(1)
+ */
+template<typename Key, typename Value,
+		int MaxKeys = aux::btree_keys<Key>::value>
+class BTree {
+	static_assert(MaxKeys >= 4, "B-tree node must hold at least 4 keys");
+
+	enum {
+		MIN_LEAF = MaxKeys / 2, // items in leaf, except root
+		MIN_INNER = (MaxKeys - 1) / 2 // keys in inner node, except root
+	};
+
+	/* Inner node with count keys has count + 1 children. Key i is the
+	 * smallest key of subtree of child i + 1 (or less than it, after
+	 * removals), and greater than all keys of subtree of child i.
+	 */
+	struct Node {
+		bool leaf;
+		int count;
+		Key keys[MaxKeys];
+		explicit Node(bool leaf) : leaf(leaf), count(0) {}
+	};
+	struct Leaf : Node {
+		Value* values[MaxKeys];
+		Leaf* next;
+		Leaf() : Node(true), next(NULL) {}
+	};
+	struct Inner : Node {
+		Node* children[MaxKeys + 1];
+		Inner() : Node(false) {}
+	};
+
+	Node* root;
+	int items;
+
+	static Leaf* as_leaf(Node* n) {
+		return static_cast<Leaf*>(n);
+	}
+	static Inner* as_inner(Node* n) {
+		return static_cast<Inner*>(n);
+	}
+
+	class btreeIterator {
+		friend class BTree;
+		Leaf *leaf;
+		int i;
+		btreeIterator(Leaf* leaf = NULL, int i = 0) : leaf(leaf), i(i) {
+			// Position past the end of a leaf is the start of the next one.
+			if (this->leaf && this->i == this->leaf->count) {
+				this->leaf = this->leaf->next;
+				this->i = 0;
+			}
+		}
+
+	public:
+		/* !IMPORTANT! iterator must be validated before.
+		 *     ++ on invalid iterators (e.g. end()) is undefined.
+		 * @Time complexity: O(1)
+		 */
+		btreeIterator& operator++() {
+			if (++i == leaf->count) {
+				leaf = leaf->next;
+				i = 0;
+			}
+			return *this;
+		}
+		btreeIterator operator++(int) {
+			btreeIterator copy(*this);
+			++(*this);
+			return copy;
+		}
+		bool operator==(const btreeIterator& it) const {
+			return leaf == it.leaf && i == it.i;
+		}
+		bool operator!=(const btreeIterator& it) const {
+			return !(*this == it);
+		}
+
+		/* !IMPORTANT! iterator must be validated before dereferencing.
+		 * @Return: reference to value of the item.
+		 */
+		Value& operator*() const {
+			return *(leaf->values[i]);
+		}
+		Key key() const {
+			return leaf->keys[i];
+		}
+		Value& value() const {
+			return *(leaf->values[i]);
+		}
+	};
+
+	/* Index of child of inner node n, which subtree may contain k.
+	 * @Time complexity: O(log(MaxKeys))
+	 */
+	static int child_index(Node* n, const Key& k) {
+		return std::upper_bound(n->keys, n->keys + n->count, k) - n->keys;
+	}
+
+	/* Descends from r to the leaf, which may contain k.
+	 * @Time complexity: O(log(n))
+	 */
+	static Leaf* leaf_of(Node* r, const Key& k) {
+		while (!r->leaf) {
+			r = as_inner(r)->children[child_index(r, k)];
+		}
+		return as_leaf(r);
+	}
+
+	/* Inserts key k and child (which follows it) to inner node n, at index
+	 * i of keys. Assumes n isn't full.
+	 */
+	static void insert_at(Inner* n, int i, const Key& k, Node* child) {
+		assert(n->count < MaxKeys);
+		for (int j = n->count; j > i; --j) {
+			n->keys[j] = n->keys[j - 1];
+			n->children[j + 1] = n->children[j];
+		}
+		n->keys[i] = k;
+		n->children[i + 1] = child;
+		++n->count;
+	}
+
+	/* Inserts item to leaf n, at index i. Assumes n isn't full. */
+	static void insert_at(Leaf* n, int i, const Key& k, Value* v) {
+		assert(n->count < MaxKeys);
+		for (int j = n->count; j > i; --j) {
+			n->keys[j] = n->keys[j - 1];
+			n->values[j] = n->values[j - 1];
+		}
+		n->keys[i] = k;
+		n->values[i] = v;
+		++n->count;
+	}
+
+	/* Removes key i and child i + 1 of inner node n. */
+	static void erase_at(Inner* n, int i) {
+		for (int j = i; j < n->count - 1; ++j) {
+			n->keys[j] = n->keys[j + 1];
+			n->children[j + 1] = n->children[j + 2];
+		}
+		--n->count;
+	}
+
+	/* Removes item i of leaf n, without freeing its value. */
+	static void erase_at(Leaf* n, int i) {
+		for (int j = i; j < n->count - 1; ++j) {
+			n->keys[j] = n->keys[j + 1];
+			n->values[j] = n->values[j + 1];
+		}
+		--n->count;
+	}
+
+	/* Recursive insertion. If node r splits, its new right sibling and the
+	 * key, which separates them, are returned through sibling and separator.
+	 * This function assumes, that tree doesn't contain an item with key k.
+	 *
+	 * @Time complexity: O(log(n)*MaxKeys)
+	 * @Memory complexity: O(log(n))
+	 */
+	static void insert_r(Node* r, const Key& k, Value* v, Node*& sibling,
+			Key& separator) {
+		sibling = NULL;
+		if (r->leaf) {
+			Leaf* leaf = as_leaf(r);
+			int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, k)
+					- leaf->keys;
+			if (leaf->count < MaxKeys) {
+				insert_at(leaf, i, k, v);
+				return;
+			}
+			Leaf* right = new Leaf();
+			int half = MaxKeys / 2;
+			for (int j = half; j < MaxKeys; ++j) {
+				right->keys[j - half] = leaf->keys[j];
+				right->values[j - half] = leaf->values[j];
+			}
+			right->count = MaxKeys - half;
+			leaf->count = half;
+			right->next = leaf->next;
+			leaf->next = right;
+			if (i <= half) {
+				insert_at(leaf, i, k, v);
+			} else {
+				insert_at(right, i - half, k, v);
+			}
+			sibling = right;
+			separator = right->keys[0];
+			return;
+		}
+		Inner* inner = as_inner(r);
+		int i = child_index(inner, k);
+		Node* child_sibling;
+		Key child_separator;
+		insert_r(inner->children[i], k, v, child_sibling, child_separator);
+		if (!child_sibling)
+			return;
+		if (inner->count < MaxKeys) {
+			insert_at(inner, i, child_separator, child_sibling);
+			return;
+		}
+		// Split: middle key moves up, the rest is divided.
+		Inner* right = new Inner();
+		int mid = MaxKeys / 2;
+		separator = inner->keys[mid];
+		for (int j = mid + 1; j < MaxKeys; ++j) {
+			right->keys[j - mid - 1] = inner->keys[j];
+		}
+		for (int j = mid + 1; j <= MaxKeys; ++j) {
+			right->children[j - mid - 1] = inner->children[j];
+		}
+		right->count = MaxKeys - mid - 1;
+		inner->count = mid;
+		if (i <= mid) {
+			insert_at(inner, i, child_separator, child_sibling);
+		} else {
+			insert_at(right, i - mid - 1, child_separator, child_sibling);
+		}
+		sibling = right;
+	}
+
+	/* Restores minimal size of child i of inner node n, by borrowing an item
+	 * from its sibling, or by merging it with the sibling.
+	 * @Time complexity: O(MaxKeys)
+	 */
+	static void fix_child(Inner* n, int i) {
+		Node* left = i > 0 ? n->children[i - 1] : NULL;
+		Node* right = i < n->count ? n->children[i + 1] : NULL;
+		Node* child = n->children[i];
+		if (child->leaf) {
+			Leaf* c = as_leaf(child);
+			if (left && left->count > MIN_LEAF) {
+				Leaf* l = as_leaf(left);
+				insert_at(c, 0, l->keys[l->count - 1], l->values[l->count - 1]);
+				--l->count;
+				n->keys[i - 1] = c->keys[0];
+			} else if (right && right->count > MIN_LEAF) {
+				Leaf* r = as_leaf(right);
+				insert_at(c, c->count, r->keys[0], r->values[0]);
+				erase_at(r, 0);
+				n->keys[i] = r->keys[0];
+			} else {
+				if (!left) { // merge right into child instead
+					c = as_leaf(right);
+					++i;
+				}
+				Leaf* l = as_leaf(n->children[i - 1]);
+				for (int j = 0; j < c->count; ++j) {
+					l->keys[l->count + j] = c->keys[j];
+					l->values[l->count + j] = c->values[j];
+				}
+				l->count += c->count;
+				l->next = c->next;
+				erase_at(n, i - 1);
+				delete c;
+			}
+			return;
+		}
+		Inner* c = as_inner(child);
+		if (left && left->count > MIN_INNER) {
+			Inner* l = as_inner(left);
+			for (int j = c->count; j > 0; --j) {
+				c->keys[j] = c->keys[j - 1];
+			}
+			for (int j = c->count + 1; j > 0; --j) {
+				c->children[j] = c->children[j - 1];
+			}
+			c->keys[0] = n->keys[i - 1];
+			c->children[0] = l->children[l->count];
+			++c->count;
+			n->keys[i - 1] = l->keys[l->count - 1];
+			--l->count;
+		} else if (right && right->count > MIN_INNER) {
+			Inner* r = as_inner(right);
+			c->keys[c->count] = n->keys[i];
+			c->children[c->count + 1] = r->children[0];
+			++c->count;
+			n->keys[i] = r->keys[0];
+			for (int j = 0; j < r->count - 1; ++j) {
+				r->keys[j] = r->keys[j + 1];
+			}
+			for (int j = 0; j < r->count; ++j) {
+				r->children[j] = r->children[j + 1];
+			}
+			--r->count;
+		} else {
+			if (!left) {
+				c = as_inner(right);
+				++i;
+			}
+			Inner* l = as_inner(n->children[i - 1]);
+			l->keys[l->count] = n->keys[i - 1];
+			for (int j = 0; j < c->count; ++j) {
+				l->keys[l->count + 1 + j] = c->keys[j];
+			}
+			for (int j = 0; j <= c->count; ++j) {
+				l->children[l->count + 1 + j] = c->children[j];
+			}
+			l->count += c->count + 1;
+			erase_at(n, i - 1);
+			delete c;
+		}
+	}
+
+	/* Recursive removal, nodes are rebalanced on the way up.
+	 *
+	 * @Return: true if item with key k was removed.
+	 * @Time complexity: O(log(n)*MaxKeys)
+	 * @Memory complexity: O(log(n))
+	 */
+	static bool remove_r(Node* r, const Key& k) {
+		if (r->leaf) {
+			Leaf* leaf = as_leaf(r);
+			int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, k)
+					- leaf->keys;
+			if (i == leaf->count || k < leaf->keys[i])
+				return false;
+			delete leaf->values[i];
+			erase_at(leaf, i);
+			return true;
+		}
+		Inner* inner = as_inner(r);
+		int i = child_index(inner, k);
+		if (!remove_r(inner->children[i], k))
+			return false;
+		Node* child = inner->children[i];
+		if (child->count < (child->leaf ? (int) MIN_LEAF : (int) MIN_INNER))
+			fix_child(inner, i);
+		return true;
+	}
+
+	/* Frees all nodes of subtree r, and values too, if free_values.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	static void destroy_r(Node* r, bool free_values) {
+		if (!r)
+			return;
+		if (r->leaf) {
+			if (free_values) {
+				for (int i = 0; i < r->count; ++i) {
+					delete as_leaf(r)->values[i];
+				}
+			}
+			delete as_leaf(r);
+			return;
+		}
+		for (int i = 0; i <= r->count; ++i) {
+			destroy_r(as_inner(r)->children[i], free_values);
+		}
+		delete as_inner(r);
+	}
+
+	/* Builds tree of sorted items, taking ownership of their values. Nodes
+	 * of each level are filled evenly, so all of them are at least half
+	 * full. If this throws, built nodes are freed, and values are left to
+	 * the caller.
+	 *
+	 * @Return: root of the new tree.
+	 * @Time complexity: O(p), where p is number of items.
+	 * @Memory complexity: O(p/MaxKeys)
+	 */
+	static Node* tree_from_items(const std::vector<std::pair<Key, Value*> >& sorted) {
+		int p = sorted.size();
+		if (!p)
+			return NULL;
+		int leaves = (p + MaxKeys - 1) / MaxKeys;
+		// All nodes, to be freed one by one if building fails. Each level is
+		// at most half of the level below, so there're < 2 * leaves of them.
+		std::vector<Node*> built;
+		built.reserve(2 * leaves);
+		try {
+			// Built nodes of current level, with smallest keys of their
+			// subtrees.
+			std::vector<std::pair<Node*, Key> > level;
+			Leaf* previous = NULL;
+			for (int l = 0, from = 0; l < leaves; ++l) {
+				int to = (int) ((long long) p * (l + 1) / leaves);
+				Leaf* leaf = new Leaf();
+				built.push_back(leaf);
+				for (int i = from; i < to; ++i) {
+					leaf->keys[i - from] = sorted[i].first;
+					leaf->values[i - from] = sorted[i].second;
+				}
+				leaf->count = to - from;
+				if (previous)
+					previous->next = leaf;
+				previous = leaf;
+				level.push_back(std::make_pair((Node*) leaf, leaf->keys[0]));
+				from = to;
+			}
+			while (level.size() > 1) {
+				int c = level.size();
+				int parents = (c + MaxKeys) / (MaxKeys + 1);
+				std::vector<std::pair<Node*, Key> > upper;
+				for (int q = 0, from = 0; q < parents; ++q) {
+					int to = (int) ((long long) c * (q + 1) / parents);
+					Inner* inner = new Inner();
+					built.push_back(inner);
+					for (int j = from; j < to; ++j) {
+						inner->children[j - from] = level[j].first;
+						if (j > from)
+							inner->keys[j - from - 1] = level[j].second;
+					}
+					inner->count = to - from - 1;
+					upper.push_back(
+							std::make_pair((Node*) inner, level[from].second));
+					from = to;
+				}
+				level.swap(upper);
+			}
+			return level[0].first;
+		} catch (...) {
+			for (size_t i = 0; i < built.size(); ++i) {
+				if (built[i]->leaf) {
+					delete as_leaf(built[i]);
+				} else {
+					delete as_inner(built[i]);
+				}
+			}
+			throw;
+		}
+	}
+
+public:
+	typedef btreeIterator iterator;
+
+	/* Default C'tor. Creates empty tree.
+	 * @Time complexity: O(1)
+	 */
+	BTree() : root(NULL), items(0) {}
+
+	/* Copy C'tor.
+	 * @Time complexity: O(m), where m is number of items in tree t.
+	 * @Memory complexity: O(m)
+	 */
+	BTree(const BTree& t) : root(NULL), items(0) {
+		merge(t);
+	}
+
+	/* Move C'tor. Takes all nodes of t, which is left empty.
+	 * @Time complexity: O(1)
+	 */
+	BTree(BTree&& t) : root(t.root), items(t.items) {
+		t.root = NULL;
+		t.items = 0;
+	}
+
+	/* Assignment operator.
+	 * @Return: *this
+	 * @Time complexity: O(n + m), where m is number of items in tree t.
+	 * @Memory complexity: O(m)
+	 */
+	BTree& operator=(const BTree& t) {
+		if (this != &t) {
+			clear();
+			merge(t);
+		}
+		return *this;
+	}
+
+	/* Move assignment operator. Takes all nodes of t, which is left empty.
+	 * @Return: *this
+	 * @Time complexity: O(n)
+	 */
+	BTree& operator=(BTree&& t) {
+		if (this != &t) {
+			clear();
+			root = t.root;
+			items = t.items;
+			t.root = NULL;
+			t.items = 0;
+		}
+		return *this;
+	}
+
+	~BTree() {
+		clear();
+	}
+
+	/* @Return: iterator to the item with smallest key, or end().
+	 * @Time complexity: O(log(n))
+	 */
+	iterator begin() const {
+		if (!root)
+			return end();
+		Node* r = root;
+		while (!r->leaf) {
+			r = as_inner(r)->children[0];
+		}
+		return iterator(as_leaf(r), 0);
+	}
+
+	/* @Return: iterator past the last item. Must not be dereferenced.
+	 * @Time complexity: O(1)
+	 */
+	iterator end() const {
+		return iterator();
+	}
+
+	/* @Return: true if tree contains no items.
+	 * @Time complexity: O(1)
+	 */
+	bool empty() const {
+		return !items;
+	}
+
+	/* @Return: number of items in tree.
+	 * @Time complexity: O(1)
+	 */
+	int size() const {
+		return items;
+	}
+
+	/* Searches the tree for item with key k.
+	 *
+	 * @Return: iterator to item with key k, or end() if it isn't present.
+	 * @Time complexity: O(log(n))
+	 */
+	iterator find(const Key& k) const {
+		if (!root)
+			return end();
+		Leaf* leaf = leaf_of(root, k);
+		int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, k)
+				- leaf->keys;
+		if (i == leaf->count || k < leaf->keys[i])
+			return end();
+		return iterator(leaf, i);
+	}
+
+	/* @Return: iterator to the first item with key not less than k, or end().
+	 * @Time complexity: O(log(n))
+	 */
+	iterator lower_bound(const Key& k) const {
+		if (!root)
+			return end();
+		Leaf* leaf = leaf_of(root, k);
+		return iterator(leaf, std::lower_bound(leaf->keys,
+				leaf->keys + leaf->count, k) - leaf->keys);
+	}
+
+	/* @Return: iterator to the first item with key greater than k, or end().
+	 * @Time complexity: O(log(n))
+	 */
+	iterator upper_bound(const Key& k) const {
+		if (!root)
+			return end();
+		Leaf* leaf = leaf_of(root, k);
+		return iterator(leaf, std::upper_bound(leaf->keys,
+				leaf->keys + leaf->count, k) - leaf->keys);
+	}
+
+	/* Inserts an item with given key k and value v.
+	 * If item is already present - tree stays unchanged, and false returned.
+	 *
+	 * @Return: false if item with key is in dictionary.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	bool insert(const Key& k, const Value& v) {
+		if (find(k) != end())
+			return false;
+		if (!root)
+			root = new Leaf();
+		Node* sibling;
+		Key separator;
+		insert_r(root, k, new Value(v), sibling, separator);
+		if (sibling) {
+			Inner* new_root = new Inner();
+			new_root->children[0] = root;
+			new_root->children[1] = sibling;
+			new_root->keys[0] = separator;
+			new_root->count = 1;
+			root = new_root;
+		}
+		++items;
+		return true;
+	}
+
+	/* Removes an item with key k from the tree.
+	 * If item with Key k isn't present - does nothing.
+	 *
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	void remove(const Key& k) {
+		if (!root || !remove_r(root, k))
+			return;
+		--items;
+		if (!root->leaf && !root->count) {
+			Node* child = as_inner(root)->children[0];
+			delete as_inner(root);
+			root = child;
+		} else if (root->leaf && !root->count) {
+			delete as_leaf(root);
+			root = NULL;
+		}
+	}
+
+	/* Frees all items.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	void clear() {
+		destroy_r(root, true);
+		root = NULL;
+		items = 0;
+	}
+
+	/* Merges t into this tree. If both trees contain items with same key,
+	 * item of this tree is kept. Items of this tree keep their values, the
+	 * tree is rebuilt from both sequences of items.
+	 * All iterators of this tree are invalidated.
+	 *
+	 * @Time complexity: O(m+n), where m is number of items in t.
+	 * @Memory complexity: O(m+n)
+	 */
+	void merge(const BTree& t) {
+		std::vector<std::pair<Key, Value*> > sorted;
+		sorted.reserve(items + t.items);
+		// Copied values of t are owned here, until the new tree is built.
+		std::vector<std::unique_ptr<Value> > copies;
+		copies.reserve(t.items);
+		iterator a = begin(), b = t.begin();
+		while (a != end() || b != t.end()) {
+			if (b == t.end() || (a != end() && a.key() < b.key())) {
+				sorted.push_back(std::make_pair(a.key(), &a.value()));
+				++a;
+			} else if (a == end() || b.key() < a.key()) {
+				copies.push_back(std::unique_ptr<Value>(new Value(b.value())));
+				sorted.push_back(std::make_pair(b.key(), copies.back().get()));
+				++b;
+			} else {
+				sorted.push_back(std::make_pair(a.key(), &a.value()));
+				++a;
+				++b;
+			}
+		}
+		Node* merged = tree_from_items(sorted);
+		for (size_t i = 0; i < copies.size(); ++i) {
+			copies[i].release();
+		}
+		items = sorted.size();
+		std::swap(root, merged);
+		destroy_r(merged, false);
+	}
+};
+
+#endif /* BTREE_HPP_ */
@@ -0,0 +1,173 @@
+/*
+ * BTree_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <gtest/gtest.h>
+#include "BTree.hpp"
+#include "Dictionary.hpp"
+
+/* Small nodes, so splits, borrows and merges happen on every level. */
+typedef BTree<int, int, 4> SmallBTree;
+
+template<typename Tree>
+static void expect_same(const Tree& tree, const std::map<int, int>& reference) {
+	ASSERT_EQ(tree.size(), (int) reference.size());
+	auto expected = reference.begin();
+	for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+		ASSERT_EQ(it.key(), expected->first);
+		ASSERT_EQ(*it, expected->second);
+	}
+	ASSERT_TRUE(expected == reference.end());
+}
+
+TEST(BTree, random_against_map) {
+	SmallBTree tree;
+	std::map<int, int> reference;
+	unsigned int seed = 1;
+	for (int i = 0; i < 30000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		int k = (seed >> 16) % 2000;
+		if ((seed >> 8) % 5 < 3) {
+			bool inserted = reference.insert(std::make_pair(k, i)).second;
+			ASSERT_EQ(tree.insert(k, i), inserted);
+		} else {
+			reference.erase(k);
+			tree.remove(k);
+		}
+		if (i % 1000 == 0)
+			expect_same(tree, reference);
+	}
+	expect_same(tree, reference);
+	for (int k = 0; k < 2000; ++k) {
+		ASSERT_EQ(tree.find(k) != tree.end(), reference.count(k) == 1);
+	}
+	for (int k = 0; k < 2000; ++k) {
+		tree.remove(k);
+	}
+	ASSERT_TRUE(tree.empty());
+	ASSERT_EQ(tree.begin(), tree.end());
+}
+
+TEST(BTree, bounds) {
+	SmallBTree tree;
+	for (int i = 0; i < 100; i += 10) {
+		tree.insert(i, i);
+	}
+	ASSERT_EQ(tree.lower_bound(30).key(), 30);
+	ASSERT_EQ(tree.lower_bound(31).key(), 40);
+	ASSERT_EQ(tree.upper_bound(30).key(), 40);
+	ASSERT_EQ(tree.lower_bound(-5).key(), 0);
+	ASSERT_EQ(tree.lower_bound(91), tree.end());
+	ASSERT_EQ(tree.upper_bound(90), tree.end());
+}
+
+TEST(BTree, merge_left_wins) {
+	SmallBTree a, b;
+	std::map<int, int> reference;
+	for (int i = 0; i < 500; i += 2) {
+		a.insert(i, 1);
+		reference[i] = 1;
+	}
+	for (int i = 0; i < 600; i += 3) {
+		b.insert(i, 2);
+		reference.insert(std::make_pair(i, 2));
+	}
+	a.merge(b);
+	expect_same(a, reference);
+	ASSERT_EQ(b.size(), 200);
+	// Merged tree keeps working.
+	for (int i = 0; i < 600; ++i) {
+		a.remove(i);
+		reference.erase(i);
+		if (i % 50 == 0)
+			expect_same(a, reference);
+	}
+	ASSERT_TRUE(a.empty());
+}
+
+/* Value, whose copy throws when countdown reaches 0. */
+struct Throwing_value {
+	static int countdown;
+	int x;
+	Throwing_value(int x) : x(x) {}
+	Throwing_value(const Throwing_value& v) : x(v.x) {
+		if (countdown >= 0 && countdown-- == 0)
+			throw std::runtime_error("copy of value");
+	}
+};
+int Throwing_value::countdown = -1;
+
+TEST(BTree, merge_is_undone_if_copy_throws) {
+	BTree<int, Throwing_value, 4> a, b;
+	for (int i = 0; i < 500; i += 2) {
+		a.insert(i, Throwing_value(1));
+	}
+	for (int i = 0; i < 600; i += 3) {
+		b.insert(i, Throwing_value(2));
+	}
+	Throwing_value::countdown = 50; // after some copies
+	ASSERT_THROW(a.merge(b), std::runtime_error);
+	Throwing_value::countdown = -1;
+	ASSERT_EQ(a.size(), 250);
+	for (auto it = a.begin(); it != a.end(); ++it) {
+		ASSERT_EQ(it.key() % 2, 0);
+		ASSERT_EQ((*it).x, 1);
+	}
+	a.merge(b);
+	ASSERT_EQ(a.size(), 250 + 200 - 84); // 84 multiples of 6 are in both
+}
+
+TEST(BTree, copy_and_move) {
+	BTree<std::string, std::string> a;
+	for (int i = 0; i < 1000; ++i) {
+		a.insert(std::to_string(i), std::to_string(i * 2));
+	}
+	BTree<std::string, std::string> b(a);
+	a.remove("10");
+	ASSERT_EQ(*b.find("10"), "20");
+	BTree<std::string, std::string> c(std::move(b));
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(c.size(), 1000);
+	b = c;
+	ASSERT_EQ(b.size(), 1000);
+	a = std::move(c);
+	ASSERT_EQ(a.size(), 1000);
+	ASSERT_TRUE(c.empty());
+}
+
+/* Same test code for each engine of Dictionary. */
+template<typename Engine>
+class DictionaryEngine: public ::testing::Test {};
+
+typedef ::testing::Types<AVLEngine, BTreeEngine> Engines;
+TYPED_TEST_SUITE(DictionaryEngine, Engines);
+
+TYPED_TEST(DictionaryEngine, same_api) {
+	Dictionary<int, int, TypeParam> d, other;
+	std::map<int, int> reference;
+	for (int i = 0; i < 300; ++i) {
+		d.insert(i * 7 % 300, i);
+		reference.insert(std::make_pair(i * 7 % 300, i));
+	}
+	for (int i = 0; i < 300; i += 3) {
+		d.remove(i);
+		reference.erase(i);
+	}
+	for (int i = 300; i < 400; ++i) {
+		other.insert(i, i);
+		reference.insert(std::make_pair(i, i));
+	}
+	d.merge(other);
+	expect_same(d, reference);
+	ASSERT_EQ(d.lower_bound(3).key(), 4);
+	ASSERT_EQ(d.upper_bound(4).key(), 5);
+	ASSERT_NE(d.find(5), d.end());
+	ASSERT_FALSE(d.empty());
+	d.clear();
+	ASSERT_TRUE(d.empty());
+}
@@ -0,0 +1,277 @@
+/*
+ * BufferedAVL.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef BUFFEREDAVL_HPP_
+#define BUFFEREDAVL_HPP_
+
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "AVL.hpp"
+
+/* AVL dictionary with a write buffer in front of it (as in LSM trees),
+ * for write bursts.
+ *
+ * Changes go to a small buffer: tree of inserted items and tree of removed
+ * keys (tombstones) of the main tree. Reads check the buffer, then the main
+ * tree. When buffer fills up, it is frozen, and a background thread merges
+ * it into a new main tree, with AVL::merge (linear, no rolls), while
+ * foreground writes continue into a fresh buffer. If buffer fills up again
+ * before background merge is done, writer waits for it.
+ *
+ * Frozen buffer and main tree are never changed, they are replaced: so
+ * background thread and foreground reads use them without locking. Only
+ * publishing of merged tree is guarded by a mutex, and foreground picks it
+ * up on the next change, so reads take no locks at all.
+ * BufferedAVL itself is used from a single thread (or synchronized
+ * externally), as AVL.
+ * If background merge throws, its buffer stays frozen (and visible to
+ * reads), the exception is rethrown by the next change or flush(), and
+ * the buffer is merged again by the one after it.
+ *
+ * Pointers, returned by find(), are valid until next change of the
+ * dictionary.
+ *
+ * @Requirements from Key and Value: same as in AVL.
+ */
+template<typename Key, typename Value>
+class BufferedAVL {
+	typedef AVL<Key, Value> Tree;
+	typedef AVL<Key, aux::none> KeySet;
+
+	/* Buffered changes. Inserted keys are never tombstoned and vice versa. */
+	struct Buffer {
+		Tree inserted;
+		KeySet removed;
+		int changes;
+		Buffer() : changes(0) {}
+	};
+
+	// Published by background merge, guarded by mutex.
+	std::shared_ptr<const Tree> main;
+	std::shared_ptr<const Buffer> frozen;
+	mutable std::mutex mutex;
+	std::thread merger;
+	std::exception_ptr merge_error; // of background merge, read after join
+
+	// Foreground view of published trees, refreshed on changes.
+	std::shared_ptr<const Tree> main_view;
+	std::shared_ptr<const Buffer> frozen_view;
+	std::unique_ptr<Buffer> active;
+	int buffer_size;
+
+	BufferedAVL(const BufferedAVL&) = delete;
+	BufferedAVL& operator=(const BufferedAVL&) = delete;
+
+	/* Skips tombstoned keys of merge: keys come in ascending order, so
+	 * tombstones are walked alongside them. */
+	class tombstones {
+		typename KeySet::iterator next, end;
+
+	public:
+		tombstones(const KeySet& removed) :
+				next(removed.begin()),
+				end(removed.end()) {}
+		bool operator()(const Key& k) {
+			while (next != end && next.key() < k) {
+				++next;
+			}
+			return next != end && !(k < next.key());
+		}
+	};
+
+	/* Builds new main tree from old one and frozen buffer, in a single
+	 * linear merge, which leaves out tombstoned keys.
+	 * Runs in background thread.
+	 *
+	 * @Time complexity: O(n + b), where b is size of the buffer.
+	 * @Memory complexity: O(n + b)
+	 */
+	static std::shared_ptr<const Tree> merge_buffer(const Tree& old_main,
+			const Buffer& buffer) {
+		std::shared_ptr<Tree> result(new Tree(buffer.inserted));
+		result->merge_except(old_main, tombstones(buffer.removed));
+		return result;
+	}
+
+	/* Picks up trees, published by background merge. */
+	void refresh() {
+		std::lock_guard<std::mutex> lock(mutex);
+		main_view = main;
+		frozen_view = frozen;
+	}
+
+	/* Waits for background merge (if any) to finish, and picks up its
+	 * result. Rethrows exception of the merge. */
+	void wait_merge() {
+		if (merger.joinable())
+			merger.join();
+		refresh();
+		if (merge_error) {
+			std::exception_ptr error = merge_error;
+			merge_error = std::exception_ptr();
+			std::rethrow_exception(error);
+		}
+	}
+
+	/* Merges buffer, left frozen by failed background merge, in foreground.
+	 * Assumes there's no background merge.
+	 *
+	 * @Time complexity: O(n + b)
+	 */
+	void merge_frozen() {
+		if (!frozen_view)
+			return;
+		std::shared_ptr<const Tree> new_main = merge_buffer(*main_view,
+				*frozen_view);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			main = new_main;
+			frozen.reset();
+		}
+		refresh();
+	}
+
+	/* Freezes active buffer, and starts merging it in background. */
+	void freeze() {
+		wait_merge();
+		merge_frozen();
+		std::shared_ptr<const Buffer> buffer(active.release());
+		active.reset(new Buffer());
+		std::shared_ptr<const Tree> old_main = main_view;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			frozen = buffer;
+		}
+		frozen_view = buffer;
+		merger = std::thread([this, old_main, buffer]() {
+			std::shared_ptr<const Tree> new_main;
+			try {
+				new_main = merge_buffer(*old_main, *buffer);
+			} catch (...) {
+				merge_error = std::current_exception();
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			main = new_main;
+			frozen.reset();
+		});
+	}
+
+	/* Looks up k in buffers, from newer to older, and in main tree.
+	 * @Return: pointer to value of k, or NULL if it isn't present.
+	 */
+	const Value* lookup(const Key& k) const {
+		typename Tree::iterator it = active->inserted.find(k);
+		if (it != active->inserted.end())
+			return &(*it);
+		if (active->removed.find(k) != active->removed.end())
+			return NULL;
+		if (frozen_view) {
+			it = frozen_view->inserted.find(k);
+			if (it != frozen_view->inserted.end())
+				return &(*it);
+			if (frozen_view->removed.find(k) != frozen_view->removed.end())
+				return NULL;
+		}
+		it = main_view->find(k);
+		return it != main_view->end() ? &(*it) : NULL;
+	}
+
+	/* Counts a change in active buffer, and freezes it, when it's full. */
+	void changed() {
+		if (++active->changes >= buffer_size)
+			freeze();
+	}
+
+public:
+	/* C'tor. Creates empty dictionary.
+	 * @buffer_size: number of buffered changes, after which buffer is merged.
+	 * @Time complexity: O(1)
+	 */
+	BufferedAVL(int buffer_size = 4096) :
+			main(new Tree()),
+			main_view(main),
+			active(new Buffer()),
+			buffer_size(buffer_size) {}
+
+	/* Waits for background merge, its exception is dropped. */
+	~BufferedAVL() {
+		if (merger.joinable())
+			merger.join();
+	}
+
+	/* Searches the dictionary for item with key k.
+	 *
+	 * @Return: pointer to value of item, or NULL if it isn't present.
+	 * @Time complexity: O(log(n) + log(b)), where b is size of the buffer.
+	 */
+	const Value* find(const Key& k) const {
+		return lookup(k);
+	}
+
+	/* Inserts an item with given key k and value v.
+	 * If item is already present - dictionary stays unchanged, and false
+	 * returned.
+	 *
+	 * @Return: false if item with key is in dictionary.
+	 * @Time complexity: O(log(n) + log(b)). Each buffer_size changes, waits
+	 *     for previous background merge, if it isn't done yet.
+	 */
+	bool insert(const Key& k, const Value& v) {
+		refresh();
+		if (lookup(k))
+			return false;
+		active->removed.remove(k);
+		active->inserted.insert(k, v);
+		changed();
+		return true;
+	}
+
+	/* Removes an element with key k from the dictionary.
+	 * If element with Key k isn't present - does nothing.
+	 *
+	 * @Time complexity: O(log(n) + log(b)), as insert.
+	 */
+	void remove(const Key& k) {
+		refresh();
+		if (!lookup(k))
+			return;
+		// Key may be in older trees too, if it was removed and inserted.
+		active->inserted.remove(k);
+		bool older = main_view->find(k) != main_view->end()
+				|| (frozen_view && frozen_view->inserted.find(k)
+						!= frozen_view->inserted.end());
+		if (older)
+			active->removed.insert(k, aux::none());
+		changed();
+	}
+
+	/* Merges all buffered changes into main tree, and waits for it.
+	 * After that, main_tree() contains the whole dictionary.
+	 * Rethrows exception of background merge.
+	 *
+	 * @Time complexity: O(n + b)
+	 */
+	void flush() {
+		wait_merge();
+		merge_frozen();
+		if (active->changes)
+			freeze();
+		wait_merge();
+	}
+
+	/* Main tree. Doesn't include buffered changes, unless flush() was called.
+	 * Tree isn't changed, it is replaced by background merge, so it's valid
+	 * while the returned pointer is held.
+	 */
+	std::shared_ptr<const Tree> main_tree() const {
+		return main_view;
+	}
+};
+
+#endif /* BUFFEREDAVL_HPP_ */
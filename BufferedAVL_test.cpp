@@ -0,0 +1,136 @@
+/*
+ * BufferedAVL_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <atomic>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <gtest/gtest.h>
+#include "BufferedAVL.hpp"
+
+TEST(BufferedAVL, insert_find_remove) {
+	BufferedAVL<int, int> dict(4);
+	for (int i = 0; i < 10; ++i) {
+		ASSERT_TRUE(dict.insert(i, i * 10));
+	}
+	ASSERT_FALSE(dict.insert(3, 0));
+	for (int i = 0; i < 10; ++i) {
+		ASSERT_NE(dict.find(i), (const int*) NULL);
+		ASSERT_EQ(*dict.find(i), i * 10);
+	}
+	ASSERT_EQ(dict.find(10), (const int*) NULL);
+	dict.remove(3);
+	dict.remove(42);
+	ASSERT_EQ(dict.find(3), (const int*) NULL);
+	ASSERT_NE(dict.find(4), (const int*) NULL);
+}
+
+TEST(BufferedAVL, reinsert_removed_key_of_main_tree) {
+	BufferedAVL<int, int> dict(100);
+	dict.insert(1, 1);
+	dict.insert(2, 2);
+	dict.flush();
+	dict.remove(1);
+	ASSERT_EQ(dict.find(1), (const int*) NULL);
+	ASSERT_TRUE(dict.insert(1, 10));
+	ASSERT_EQ(*dict.find(1), 10);
+	dict.remove(1);
+	ASSERT_EQ(dict.find(1), (const int*) NULL);
+	dict.flush();
+	ASSERT_EQ(dict.find(1), (const int*) NULL);
+	ASSERT_EQ(dict.main_tree()->size(), 1);
+}
+
+TEST(BufferedAVL, flush) {
+	BufferedAVL<int, int> dict(1000);
+	for (int i = 0; i < 50; ++i) {
+		dict.insert(i, i);
+	}
+	dict.remove(7);
+	ASSERT_EQ(dict.main_tree()->size(), 0);
+	dict.flush();
+	std::shared_ptr<const AVL<int, int> > main = dict.main_tree();
+	ASSERT_EQ(main->size(), 49);
+	int expected = 0;
+	for (auto it = main->begin(); it != main->end(); ++it, ++expected) {
+		if (expected == 7)
+			++expected;
+		ASSERT_EQ(it.key(), expected);
+	}
+}
+
+TEST(BufferedAVL, random_against_map) {
+	BufferedAVL<int, int> dict(16);
+	std::map<int, int> reference;
+	unsigned int seed = 12345;
+	for (int i = 0; i < 20000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		int k = (seed >> 16) % 500;
+		if ((seed >> 8) % 3) {
+			bool inserted = reference.insert(std::make_pair(k, i)).second;
+			ASSERT_EQ(dict.insert(k, i), inserted);
+		} else {
+			reference.erase(k);
+			dict.remove(k);
+		}
+		if (i % 97 == 0) {
+			for (int j = 0; j < 500; ++j) {
+				auto it = reference.find(j);
+				const int* v = dict.find(j);
+				ASSERT_EQ(v != NULL, it != reference.end());
+				if (v) {
+					ASSERT_EQ(*v, it->second);
+				}
+			}
+		}
+	}
+	dict.flush();
+	std::shared_ptr<const AVL<int, int> > main = dict.main_tree();
+	ASSERT_EQ(main->size(), (int) reference.size());
+	auto expected = reference.begin();
+	for (auto it = main->begin(); it != main->end(); ++it, ++expected) {
+		ASSERT_EQ(it.key(), expected->first);
+		ASSERT_EQ(*it, expected->second);
+	}
+}
+
+/* Value, which fails to copy outside of the main thread on demand, i.e.
+ * in background merge. */
+struct MergeFragile {
+	static std::atomic<bool> fail;
+	static std::thread::id main_thread;
+	int value;
+	MergeFragile(int value) : value(value) {}
+	MergeFragile(const MergeFragile& v) : value(v.value) {
+		if (fail && std::this_thread::get_id() != main_thread)
+			throw std::runtime_error("merge failed");
+	}
+};
+std::atomic<bool> MergeFragile::fail(false);
+std::thread::id MergeFragile::main_thread;
+
+TEST(BufferedAVL, failed_merge_is_rethrown_and_retried) {
+	MergeFragile::main_thread = std::this_thread::get_id();
+	BufferedAVL<int, MergeFragile> dict(4);
+	dict.insert(0, MergeFragile(0));
+	dict.flush();
+	dict.remove(0);
+	MergeFragile::fail = true;
+	for (int i = 1; i < 4; ++i) {
+		dict.insert(i, MergeFragile(i)); // last one starts the merge
+	}
+	ASSERT_THROW(dict.flush(), std::runtime_error);
+	MergeFragile::fail = false;
+	// Frozen buffer is still read
+	ASSERT_EQ(dict.find(0), (const MergeFragile*) NULL);
+	ASSERT_EQ(dict.find(2)->value, 2);
+	dict.flush();
+	ASSERT_EQ(dict.main_tree()->size(), 3);
+	ASSERT_EQ(dict.main_tree()->find(0), dict.main_tree()->end());
+	for (int i = 1; i < 4; ++i) {
+		ASSERT_EQ(dict.find(i)->value, i);
+	}
+}
@@ -0,0 +1,40 @@
+/*
+ * Dictionary.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef DICTIONARY_HPP_
+#define DICTIONARY_HPP_
+
+#include "AVL.hpp"
+#include "BTree.hpp"
+
+/* Engines of ordered dictionary. All of them have the same public API:
+ * insert(k, v), find(k), remove(k), merge(t), lower_bound(k),
+ * upper_bound(k), in-order iteration by begin() and end(), size(), empty()
+ * and clear(). So engine is switched at a single place, without touching
+ * the call sites.
+ */
+struct AVLEngine {
+	template<typename Key, typename Value>
+	struct tree {
+		typedef AVL<Key, Value> type;
+	};
+};
+
+/* B+ tree with wide nodes (see BTree.hpp). */
+struct BTreeEngine {
+	template<typename Key, typename Value>
+	struct tree {
+		typedef BTree<Key, Value> type;
+	};
+};
+
+/* Ordered dictionary on given engine, e.g.
+ *     Dictionary<int, std::string, BTreeEngine> d;
+ */
+template<typename Key, typename Value, typename Engine = AVLEngine>
+using Dictionary = typename Engine::template tree<Key, Value>::type;
+
+#endif /* DICTIONARY_HPP_ */
@@ -0,0 +1,443 @@
+/*
+ * DurableAVL.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef DURABLEAVL_HPP_
+#define DURABLEAVL_HPP_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "AVL.hpp"
+
+/* AVL dictionary, which persists its changes to local files:
+ * write-ahead log of insertions and removals, and a checkpoint - snapshot
+ * of the whole tree (see AVL::save()).
+ *
+ * Changes are appended to in-memory buffer, and written to the log by
+ * commit() with a single write and a single fdatasync for all of them
+ * (group commit). commit() is also called automatically after every
+ * group_size changes, and by destructor. Only committed changes survive
+ * a crash. Automatic commits don't report errors: a failed one leaves
+ * changes pending, to be retried, so durability is confirmed only by
+ * commit() returning true.
+ * Checkpoint is made by checkpoint(), or by maintain(), once log grows over
+ * checkpoint_bytes: snapshot is written to a temporary file, synced and
+ * renamed over the checkpoint, and log is truncated. It takes O(n), so it's
+ * never made by changes or commits: maintain() is meant to be called at
+ * idle time (e.g. by the event loop, between requests).
+ *
+ * Recovery (open()) loads the checkpoint, and replays the log. Consecutive
+ * insertions are collected into sorted runs, which are built into a tree in
+ * linear time and merged into the dictionary (or inserted one by one, if
+ * run is small compared to the dictionary). Log ends at the first torn or
+ * corrupted record, which is cut off.
+ * Only changes are logged, so replaying the log over a checkpoint, which
+ * already includes it (crash between checkpoint and log truncation), gives
+ * the same dictionary.
+ *
+ * @Requirements from Key and Value: same as in AVL, and must be supported
+ *     by codecs (see AVLCodec.hpp).
+ */
+template<typename Key, typename Value, typename KeyCodec = BinaryCodec<Key>,
+		typename ValueCodec = BinaryCodec<Value> >
+class DurableAVL {
+	typedef AVL<Key, Value> Tree;
+	typedef std::pair<Key, Value> Item;
+
+	enum {
+		RECORD_INSERT = 1,
+		RECORD_REMOVE = 2,
+		RECORD_HEADER_SIZE = 8
+	};
+
+	/* Output stream buffer, which writes to file descriptor. */
+	class FileBuffer: public std::streambuf {
+		int fd;
+		std::vector<char> buffer;
+
+		bool write_buffer() {
+			bool ok = write_all(fd, pbase(), pptr() - pbase());
+			setp(&buffer[0], &buffer[0] + buffer.size());
+			return ok;
+		}
+
+	protected:
+		int_type overflow(int_type c) {
+			if (!write_buffer())
+				return traits_type::eof();
+			if (!traits_type::eq_int_type(c, traits_type::eof())) {
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+			return traits_type::not_eof(c);
+		}
+		int sync() {
+			return write_buffer() ? 0 : -1;
+		}
+
+	public:
+		FileBuffer(int fd) : fd(fd), buffer(1 << 16) {
+			setp(&buffer[0], &buffer[0] + buffer.size());
+		}
+	};
+
+	Tree tree;
+	int count; // items in tree, as its size() is O(n)
+	std::string checkpoint_path, log_path;
+	int log_fd;
+	int group_size;
+	size_t checkpoint_bytes;
+	size_t log_bytes;
+	std::string pending;
+	int pending_records;
+
+	DurableAVL(const DurableAVL&) = delete;
+	DurableAVL& operator=(const DurableAVL&) = delete;
+
+	/* Writes all size bytes of data to fd.
+	 * @Return: false on I/O error.
+	 */
+	static bool write_all(int fd, const char* data, size_t size) {
+		while (size > 0) {
+			ssize_t written = ::write(fd, data, size);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			data += written;
+			size -= written;
+		}
+		return true;
+	}
+
+	/* FNV-1a hash of data, used to detect torn and corrupted records. */
+	static uint32_t checksum(const std::string& data) {
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < data.size(); ++i) {
+			hash = (hash ^ (unsigned char) data[i]) * 16777619u;
+		}
+		return hash;
+	}
+
+	/* Appends log record to pending buffer: payload size and checksum,
+	 * followed by payload - record type, key and value (for insertions). */
+	void append(char type, const Key& k, const Value* v) {
+		std::ostringstream payload;
+		payload.put(type);
+		KeyCodec::write(payload, k);
+		if (v)
+			ValueCodec::write(payload, *v);
+		std::string data = payload.str();
+		std::ostringstream record;
+		BinaryCodec<uint32_t>::write(record, data.size());
+		BinaryCodec<uint32_t>::write(record, checksum(data));
+		record.write(data.data(), data.size());
+		pending += record.str();
+		if (++pending_records >= group_size)
+			flush();
+	}
+
+	/* Orders items by key only. */
+	static bool key_less(const Item* a, const Item* b) {
+		return a->first < b->first;
+	}
+
+	/* Applies run of logged insertions to the tree. Run is sorted, and for
+	 * each key only first insertion is kept, as later ones would fail.
+	 * Merge costs O(n + p), so small runs are inserted one by one.
+	 *
+	 * @Time complexity: O(min(n + p*log(p), p*log(n + p)), where p is size
+	 *     of the run.
+	 * @Memory complexity: O(p)
+	 */
+	void apply_run(std::vector<Item>& run) {
+		if (run.empty())
+			return;
+		std::vector<const Item*> order;
+		for (size_t i = 0; i < run.size(); ++i) {
+			order.push_back(&run[i]);
+		}
+		std::stable_sort(order.begin(), order.end(), key_less);
+		std::vector<Item> sorted;
+		sorted.reserve(order.size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			if (i == 0 || key_less(order[i - 1], order[i]))
+				sorted.push_back(*order[i]);
+		}
+		run.clear();
+		int log_n = 1;
+		while ((1 << log_n) <= count && log_n < 30) {
+			++log_n;
+		}
+		if ((double) sorted.size() * log_n >= count) {
+			Tree batch;
+			batch.assign_sorted(sorted.begin(), sorted.end());
+			tree.merge(batch);
+			count = tree.size(); // O(n + p), as the merge
+		} else {
+			for (size_t i = 0; i < sorted.size(); ++i) {
+				count += tree.insert(sorted[i].first, sorted[i].second);
+			}
+		}
+	}
+
+	/* Replays log records from stream, till its end or till the first
+	 * invalid record.
+	 *
+	 * @Return: size of the valid part of the log, in bytes.
+	 * @Time complexity: O(r*log(n)) in worst case, where r is number of
+	 *     records.
+	 */
+	size_t replay(std::istream& is) {
+		std::vector<Item> run;
+		size_t valid_bytes = 0;
+		while (true) {
+			uint32_t size = BinaryCodec<uint32_t>::read(is);
+			uint32_t sum = BinaryCodec<uint32_t>::read(is);
+			if (!is || size == 0)
+				break;
+			std::string data;
+			char chunk[4096];
+			for (uint32_t left = size; is && left > 0;) {
+				std::streamsize n = left < sizeof(chunk) ? left : sizeof(chunk);
+				is.read(chunk, n);
+				data.append(chunk, is.gcount());
+				left -= n;
+			}
+			if (data.size() != size || checksum(data) != sum)
+				break;
+			std::istringstream payload(data);
+			int type = payload.get();
+			Key k = KeyCodec::read(payload);
+			if (type == RECORD_INSERT) {
+				Value v = ValueCodec::read(payload);
+				if (!payload)
+					break;
+				run.push_back(Item(k, v));
+			} else if (type == RECORD_REMOVE && payload) {
+				apply_run(run);
+				count -= !tree.extract(k).empty();
+			} else {
+				break;
+			}
+			valid_bytes += RECORD_HEADER_SIZE + size;
+		}
+		apply_run(run);
+		return valid_bytes;
+	}
+
+	/* Writes pending records to the log, and syncs it. On failure, log is
+	 * truncated back to its last synced size, and records stay pending.
+	 * @Return: false on I/O error.
+	 */
+	bool flush() {
+		if (pending.empty())
+			return true;
+		if (log_fd < 0)
+			return false;
+		if (!write_all(log_fd, pending.data(), pending.size())
+				|| fdatasync(log_fd) != 0) {
+			if (ftruncate(log_fd, log_bytes) != 0) {
+				// Nothing else to do, torn record is cut off on recovery.
+			}
+			return false;
+		}
+		log_bytes += pending.size();
+		pending.clear();
+		pending_records = 0;
+		return true;
+	}
+
+	/* Syncs directory entry of path, e.g. after rename. */
+	static bool sync_directory(const std::string& path) {
+		size_t slash = path.rfind('/');
+		std::string dir = slash == std::string::npos ? "." :
+				slash == 0 ? "/" : path.substr(0, slash);
+		int fd = ::open(dir.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		bool ok = fsync(fd) == 0;
+		::close(fd);
+		return ok;
+	}
+
+public:
+	/* C'tor. Creates closed dictionary, open() must be called before use.
+	 * @group_size: number of changes, after which they are committed.
+	 * @checkpoint_bytes: log size, after which maintain() checkpoints the
+	 *     tree, 0 for checkpoints by checkpoint() only.
+	 * @Time complexity: O(1)
+	 */
+	DurableAVL(const std::string& checkpoint_path, const std::string& log_path,
+			int group_size = 64, size_t checkpoint_bytes = 64 << 20) :
+			count(0),
+			checkpoint_path(checkpoint_path),
+			log_path(log_path),
+			log_fd(-1),
+			group_size(group_size),
+			checkpoint_bytes(checkpoint_bytes),
+			log_bytes(0),
+			pending_records(0) {}
+
+	/* Commits pending changes and closes the log. */
+	~DurableAVL() {
+		commit();
+		if (log_fd >= 0)
+			::close(log_fd);
+	}
+
+	/* Recovers the dictionary from checkpoint and log files (missing files
+	 * are treated as empty), and opens log for appending.
+	 *
+	 * @Return: false if checkpoint is corrupted, or on I/O error.
+	 * @Time complexity: O(c + r*log(n)), where c is checkpoint size, and r is
+	 *     number of log records.
+	 */
+	bool open() {
+		if (log_fd >= 0)
+			return false;
+		tree.clear();
+		count = 0;
+		std::ifstream checkpoint(checkpoint_path.c_str(), std::ios::binary);
+		if (checkpoint.is_open()
+				&& !tree.template load<KeyCodec, ValueCodec>(checkpoint))
+			return false;
+		count = tree.size();
+		std::ifstream log(log_path.c_str(), std::ios::binary);
+		size_t valid_bytes = log.is_open() ? replay(log) : 0;
+		log_fd = ::open(log_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (log_fd < 0)
+			return false;
+		if (ftruncate(log_fd, valid_bytes) != 0 || fdatasync(log_fd) != 0) {
+			::close(log_fd);
+			log_fd = -1;
+			return false;
+		}
+		log_bytes = valid_bytes;
+		return true;
+	}
+
+	/* Inserts an item, as AVL::insert() does, and logs it.
+	 * The change is durable only after commit() returns true.
+	 *
+	 * @Return: false if item with key is in dictionary.
+	 * @Time complexity: O(log(n)), and a commit every group_size changes.
+	 */
+	bool insert(const Key& k, const Value& v) {
+		if (!tree.insert(k, v))
+			return false;
+		++count;
+		append(RECORD_INSERT, k, &v);
+		return true;
+	}
+
+	/* Removes an item, as AVL::remove() does, and logs it.
+	 * The change is durable only after commit() returns true.
+	 *
+	 * @Return: false if there was no item with key k.
+	 * @Time complexity: O(log(n)), and a commit every group_size changes.
+	 */
+	bool remove(const Key& k) {
+		if (tree.extract(k).empty())
+			return false;
+		--count;
+		append(RECORD_REMOVE, k, NULL);
+		return true;
+	}
+
+	/* Makes all changes durable: writes them to the log and syncs it.
+	 *
+	 * @Return: false on I/O error, changes stay pending then.
+	 * @Time complexity: O(p), where p is number of pending changes.
+	 */
+	bool commit() {
+		return flush();
+	}
+
+	/* Whether log grew over checkpoint_bytes, so maintain() would make a
+	 * checkpoint.
+	 * @Time complexity: O(1)
+	 */
+	bool checkpoint_due() const {
+		return checkpoint_bytes && log_bytes >= checkpoint_bytes;
+	}
+
+	/* Maintenance hook, for idle time: checkpoints the tree, if it's due.
+	 *
+	 * @Return: false on I/O error.
+	 * @Time complexity: O(1), or O(n) if checkpoint is made.
+	 */
+	bool maintain() {
+		return !checkpoint_due() || checkpoint();
+	}
+
+	/* Commits pending changes, writes snapshot of the tree to checkpoint
+	 * file (atomically, by rename) and truncates the log.
+	 *
+	 * @Return: false on I/O error, previous checkpoint and log stay valid.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	bool checkpoint() {
+		if (log_fd < 0 || !flush())
+			return false;
+		std::string tmp_path = checkpoint_path + ".tmp";
+		int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			return false;
+		bool ok;
+		{
+			FileBuffer buffer(fd);
+			std::ostream os(&buffer);
+			ok = tree.template save<KeyCodec, ValueCodec>(os);
+			ok = ok && os.flush() && fsync(fd) == 0;
+		}
+		ok = ::close(fd) == 0 && ok;
+		if (!ok || rename(tmp_path.c_str(), checkpoint_path.c_str()) != 0) {
+			unlink(tmp_path.c_str());
+			return false;
+		}
+		if (!sync_directory(checkpoint_path))
+			return false;
+		if (ftruncate(log_fd, 0) != 0 || fdatasync(log_fd) != 0)
+			return false;
+		log_bytes = 0;
+		return true;
+	}
+
+	/* Read access to the dictionary, e.g. find() and iteration. */
+	const Tree& dictionary() const {
+		return tree;
+	}
+
+	typename Tree::iterator find(const Key& k) const {
+		return tree.find(k);
+	}
+	typename Tree::iterator begin() const {
+		return tree.begin();
+	}
+	typename Tree::iterator end() const {
+		return tree.end();
+	}
+	/* @Time complexity: O(1) */
+	int size() const {
+		return count;
+	}
+	bool empty() const {
+		return tree.empty();
+	}
+};
+
+#endif /* DURABLEAVL_HPP_ */
@@ -0,0 +1,184 @@
+/*
+ * DurableAVL_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <gtest/gtest.h>
+#include "DurableAVL.hpp"
+
+typedef DurableAVL<int, std::string> durable_tree;
+
+/* Fixture, which provides paths of checkpoint and log in a new directory */
+class DurableAVLTest: public ::testing::Test {
+protected:
+	std::string dir, checkpoint, log;
+
+	void SetUp() {
+		char path[] = "/tmp/avl_durable_XXXXXX";
+		dir = mkdtemp(path);
+		checkpoint = dir + "/checkpoint";
+		log = dir + "/log";
+	}
+	void TearDown() {
+		std::remove(checkpoint.c_str());
+		std::remove(log.c_str());
+		std::remove(dir.c_str());
+	}
+
+	static void expect_equal(const durable_tree& tree,
+			const std::map<int, std::string>& reference) {
+		ASSERT_EQ(tree.size(), (int) reference.size());
+		auto expected = reference.begin();
+		for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+			ASSERT_EQ(it.key(), expected->first);
+			ASSERT_EQ(*it, expected->second);
+		}
+	}
+};
+
+TEST_F(DurableAVLTest, recover_from_log) {
+	{
+		durable_tree tree(checkpoint, log);
+		ASSERT_TRUE(tree.open());
+		ASSERT_TRUE(tree.insert(1, "one"));
+		ASSERT_TRUE(tree.insert(2, "two"));
+		ASSERT_FALSE(tree.insert(2, "second two"));
+		ASSERT_TRUE(tree.remove(1));
+		ASSERT_FALSE(tree.remove(1));
+		ASSERT_TRUE(tree.insert(1, "new one"));
+	}
+	durable_tree tree(checkpoint, log);
+	ASSERT_TRUE(tree.open());
+	expect_equal(tree, { { 1, "new one" }, { 2, "two" } });
+}
+
+TEST_F(DurableAVLTest, checkpoint_truncates_log) {
+	std::map<int, std::string> reference;
+	{
+		durable_tree tree(checkpoint, log);
+		ASSERT_TRUE(tree.open());
+		for (int i = 0; i < 100; ++i) {
+			tree.insert(i, std::to_string(i));
+			reference[i] = std::to_string(i);
+		}
+		ASSERT_TRUE(tree.checkpoint());
+		std::ifstream log_file(log.c_str(), std::ios::ate | std::ios::binary);
+		ASSERT_EQ(log_file.tellg(), 0);
+		tree.remove(50);
+		reference.erase(50);
+	}
+	durable_tree tree(checkpoint, log);
+	ASSERT_TRUE(tree.open());
+	expect_equal(tree, reference);
+}
+
+TEST_F(DurableAVLTest, torn_log_tail_is_cut_off) {
+	{
+		durable_tree tree(checkpoint, log);
+		ASSERT_TRUE(tree.open());
+		tree.insert(1, "one");
+	}
+	{
+		std::ofstream log_file(log.c_str(), std::ios::app | std::ios::binary);
+		log_file << "\x10\0\0\0garbage";
+	}
+	{
+		durable_tree tree(checkpoint, log);
+		ASSERT_TRUE(tree.open());
+		tree.insert(2, "two");
+	}
+	durable_tree tree(checkpoint, log);
+	ASSERT_TRUE(tree.open());
+	expect_equal(tree, { { 1, "one" }, { 2, "two" } });
+}
+
+TEST_F(DurableAVLTest, corrupted_checkpoint_fails_open) {
+	{
+		std::ofstream checkpoint_file(checkpoint.c_str(), std::ios::binary);
+		checkpoint_file << "corrupted";
+	}
+	durable_tree tree(checkpoint, log);
+	ASSERT_FALSE(tree.open());
+}
+
+TEST_F(DurableAVLTest, random_with_maintenance_checkpoints) {
+	std::map<int, std::string> reference;
+	unsigned int seed = 13;
+	for (int round = 0; round < 5; ++round) {
+		durable_tree tree(checkpoint, log, 16, 4096);
+		ASSERT_TRUE(tree.open());
+		expect_equal(tree, reference);
+		for (int i = 0; i < 2000; ++i) {
+			seed = seed * 1103515245 + 12345;
+			int k = (seed / 65536) % 700;
+			if (i % 3 == 2) {
+				ASSERT_EQ(tree.remove(k), reference.erase(k) == 1);
+			} else if (tree.insert(k, std::to_string(i))) {
+				reference[k] = std::to_string(i);
+			}
+			if (i % 100 == 99) {
+				ASSERT_TRUE(tree.maintain());
+			}
+		}
+	}
+	durable_tree tree(checkpoint, log);
+	ASSERT_TRUE(tree.open());
+	expect_equal(tree, reference);
+}
+
+TEST_F(DurableAVLTest, changes_never_checkpoint) {
+	durable_tree tree(checkpoint, log, 4, 256);
+	ASSERT_TRUE(tree.open());
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i, std::to_string(i));
+	}
+	ASSERT_TRUE(tree.commit());
+	ASSERT_TRUE(tree.checkpoint_due());
+	std::ifstream checkpoint_file(checkpoint.c_str());
+	ASSERT_FALSE(checkpoint_file.is_open());
+	ASSERT_TRUE(tree.maintain());
+	ASSERT_FALSE(tree.checkpoint_due());
+	std::ifstream log_file(log.c_str(), std::ios::ate | std::ios::binary);
+	ASSERT_EQ(log_file.tellg(), 0);
+}
+
+TEST_F(DurableAVLTest, replay_is_idempotent_over_checkpoint) {
+	std::map<int, std::string> reference;
+	{
+		durable_tree tree(checkpoint, log, 1, 0);
+		ASSERT_TRUE(tree.open());
+		for (int i = 0; i < 300; ++i) {
+			tree.insert(i % 37, std::to_string(i));
+			if (i % 5 == 0)
+				tree.remove(i % 37);
+		}
+		ASSERT_TRUE(tree.commit());
+		for (auto it = tree.begin(); it != tree.end(); ++it) {
+			reference[it.key()] = *it;
+		}
+	}
+	// Checkpoint of the final state next to the full log, as after a crash
+	// between checkpoint rename and log truncation.
+	std::string saved_log;
+	{
+		std::ifstream log_file(log.c_str(), std::ios::binary);
+		saved_log.assign(std::istreambuf_iterator<char>(log_file),
+				std::istreambuf_iterator<char>());
+		durable_tree tree(checkpoint, log);
+		ASSERT_TRUE(tree.open());
+		ASSERT_TRUE(tree.checkpoint());
+	}
+	{
+		std::ofstream log_file(log.c_str(), std::ios::binary);
+		log_file << saved_log;
+	}
+	durable_tree tree(checkpoint, log);
+	ASSERT_TRUE(tree.open());
+	expect_equal(tree, reference);
+}
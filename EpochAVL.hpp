@@ -0,0 +1,424 @@
+/*
+ * EpochAVL.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef EPOCHAVL_HPP_
+#define EPOCHAVL_HPP_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "AVL.hpp"
+
+namespace aux {
+/* Reader's announcement of the epoch it's reading in, 0 if none.
+ * Each one on its own cache line, so readers don't share lines. */
+struct alignas(64) readerSlot {
+	std::atomic<bool> busy;
+	std::atomic<unsigned long long> epoch;
+	readerSlot() : busy(false), epoch(0) {}
+};
+}
+
+/* AVL dictionary for a single writer and many readers, where readers take
+ * no locks, and don't write to any shared cache line.
+ *
+ * Published nodes are never changed: writer copies the path to the
+ * changed node (and nodes moved by rolls), links the copies to the
+ * unchanged subtrees, and publishes the new root by a single atomic store.
+ * So a reader sees the tree either before or after each change, never in
+ * between. Replaced nodes are retired, and freed by the epoch-based
+ * reclamation, once no reader can reach them: reader announces the epoch
+ * in its slot for the time of a read_guard, and retired nodes are freed
+ * when all announced epochs are later than their retirement.
+ *
+ * Nodes have no parent links (AncestorStack layout), as subtrees are shared
+ * by versions of the tree, and iterators of read_guard keep ancestors.
+ *
+ * Writes are serialized by a mutex (intended for a single writer thread).
+ * Change costs O(log(n)) node copies, values aren't copied.
+ *
+ * @Requirements from Key and Value: same as in AVL.
+ */
+template<typename Key, typename Value, typename Augment = NoAugment>
+class EpochAVL: protected AVL<Key, Value, Augment, AncestorStack> {
+	typedef AVL<Key, Value, Augment, AncestorStack> Base;
+	typedef typename Base::Node Node;
+	typedef typename Base::ancestors ancestors;
+
+	enum {
+		READER_SLOTS = 128,
+		// Retired nodes are reclaimed once there're this many of them.
+		RECLAIM_BATCH = 64
+	};
+
+	/* Replaced node, freed at reclamation. Its value is freed too, unless
+	 * it's taken by a copy of the node. */
+	struct Retired {
+		unsigned long long epoch;
+		Node* node;
+		bool value_taken;
+	};
+
+	/* Nodes of a change in progress: new ones (copies and inserted node),
+	 * and replaced and removed ones, to be retired when the change is
+	 * published. */
+	struct Change {
+		std::unordered_set<Node*> fresh; // copies
+		std::vector<Node*> replaced; // values are taken by copies
+		std::vector<Node*> removed; // retired with values
+		Node* inserted; // owns its value
+		Change() : inserted(NULL) {}
+	};
+
+	std::atomic<Node*> published;
+	std::atomic<unsigned long long> epoch;
+	mutable aux::readerSlot slots[READER_SLOTS];
+	std::mutex writer;
+	std::vector<Retired> retired;
+
+	/* Frees node n of retired or abandoned change, without its value if
+	 * value is taken. Node must be unreachable by readers.
+	 */
+	static void free_detached(Node* n, bool value_taken) {
+		if (value_taken)
+			n->value = NULL;
+		Base::free_node(n);
+	}
+
+	/* Copy of published node n, which takes its value and links.
+	 * n is replaced by the copy. New nodes of the change are returned as is.
+	 * @Time complexity: O(1) expected.
+	 */
+	static Node* own(Node* n, Change& c) {
+		if (n == c.inserted || c.fresh.count(n))
+			return n;
+		Node* copy = new Node(n->key, n->value);
+		try {
+			c.fresh.insert(copy);
+		} catch (...) {
+			free_detached(copy, true);
+			throw;
+		}
+		copy->left = n->left;
+		copy->right = n->right;
+		copy->height = n->height;
+		Base::update(copy);
+		c.replaced.push_back(n);
+		return copy;
+	}
+
+	/* Same as AVL::check_and_roll() for new node r, but nodes moved by the
+	 * roll are copied first.
+	 * @Return: updated root of rebalanced sub-tree.
+	 */
+	static Node* rebalance(Node* r, Change& c) {
+		Base::update(r);
+		int balance = Base::balance(r);
+		if (balance > 1) {
+			r->left = own(r->left, c);
+			if (Base::balance(r->left) < 0)
+				r->left->right = own(r->left->right, c);
+		} else if (balance < -1) {
+			r->right = own(r->right, c);
+			if (Base::balance(r->right) > 0)
+				r->right->left = own(r->right->left, c);
+		} else {
+			return r;
+		}
+		return Base::check_and_roll(r);
+	}
+
+	/* Path-copying insertion of new node n, which key isn't in subtree r.
+	 * @Return: root of the new version of subtree r.
+	 * @Time complexity: O(log(n)) expected.
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* insert_r(Node* n, Node* r, Change& c) {
+		if (!r)
+			return n;
+		Node* x = own(r, c);
+		if (n->key < x->key) {
+			x->left = insert_r(n, x->left, c);
+		} else {
+			x->right = insert_r(n, x->right, c);
+		}
+		return rebalance(x, c);
+	}
+
+	/* Path-copying removal of leftmost node of subtree r, which isn't
+	 * empty. Unlinked node is returned through min.
+	 */
+	static Node* remove_leftmost_r(Node* r, Node*& min, Change& c) {
+		if (!r->left) {
+			min = r;
+			return r->right;
+		}
+		Node* x = own(r, c);
+		x->left = remove_leftmost_r(x->left, min, c);
+		return rebalance(x, c);
+	}
+
+	/* Path-copying removal of node with key k, which is in subtree r.
+	 * Node with 2 children is replaced by a copy of the next node.
+	 * @Return: root of the new version of subtree r.
+	 * @Time complexity: O(log(n)) expected.
+	 * @Memory complexity: O(log(n))
+	 */
+	static Node* remove_r(const Key& k, Node* r, Change& c) {
+		if (k < r->key) {
+			Node* x = own(r, c);
+			x->left = remove_r(k, x->left, c);
+			return rebalance(x, c);
+		}
+		if (r->key < k) {
+			Node* x = own(r, c);
+			x->right = remove_r(k, x->right, c);
+			return rebalance(x, c);
+		}
+		c.removed.push_back(r);
+		if (!r->left || !r->right)
+			return r->left ? r->left : r->right;
+		Node* next;
+		Node* right = remove_leftmost_r(r->right, next, c);
+		Node* x = own(next, c);
+		x->left = r->left;
+		x->right = right;
+		return rebalance(x, c);
+	}
+
+	/* Publishes root of the tree after change c, and retires its replaced
+	 * nodes.
+	 */
+	void publish(Node* new_root, Change& c) {
+		retired.reserve(retired.size() + c.replaced.size() + c.removed.size());
+		this->root = new_root;
+		published.store(new_root, std::memory_order_seq_cst);
+		unsigned long long retired_at = epoch.fetch_add(1,
+				std::memory_order_seq_cst);
+		for (size_t i = 0; i < c.replaced.size(); ++i) {
+			Retired r = { retired_at, c.replaced[i], true };
+			retired.push_back(r);
+		}
+		for (size_t i = 0; i < c.removed.size(); ++i) {
+			Retired r = { retired_at, c.removed[i], false };
+			retired.push_back(r);
+		}
+		if (retired.size() >= RECLAIM_BATCH)
+			reclaim_retired();
+	}
+
+	/* Frees new nodes of a failed change. Published tree is unchanged. */
+	static void abandon(Change& c) {
+		for (typename std::unordered_set<Node*>::iterator it = c.fresh.begin();
+				it != c.fresh.end(); ++it) {
+			free_detached(*it, true);
+		}
+		if (c.inserted)
+			free_detached(c.inserted, false);
+	}
+
+	/* Frees retired nodes, which no reader can reach, i.e. retired before
+	 * the earliest announced epoch.
+	 * @Time complexity: O(r + READER_SLOTS), where r is number of retired.
+	 */
+	void reclaim_retired() {
+		unsigned long long earliest = epoch.load(std::memory_order_seq_cst);
+		for (int i = 0; i < READER_SLOTS; ++i) {
+			unsigned long long e = slots[i].epoch.load(std::memory_order_seq_cst);
+			if (e && e < earliest)
+				earliest = e;
+		}
+		size_t kept = 0;
+		for (size_t i = 0; i < retired.size(); ++i) {
+			if (retired[i].epoch < earliest) {
+				free_detached(retired[i].node, retired[i].value_taken);
+			} else {
+				retired[kept++] = retired[i];
+			}
+		}
+		retired.resize(kept);
+	}
+
+	/* Appends all nodes of subtree r to nodes. */
+	static void nodes_r(Node* r, std::vector<Node*>& nodes) {
+		if (!r)
+			return;
+		nodes.push_back(r);
+		nodes_r(r->left, nodes);
+		nodes_r(r->right, nodes);
+	}
+
+public:
+	typedef typename Base::iterator iterator;
+
+	/* Lock-free read access to the tree, as it was when the guard was
+	 * created: changes of the writer after that aren't seen. Nodes of this
+	 * version aren't freed while the guard exists, so iterators (and
+	 * references to values) are valid until then.
+	 * Guard is used by a single thread, and tree must outlive it.
+	 */
+	class read_guard {
+		aux::readerSlot* slot;
+		Node* root;
+
+	public:
+		/* Announces the current epoch in a free slot, and takes the
+		 * published tree.
+		 * @Time complexity: O(1), if slots aren't all busy.
+		 */
+		explicit read_guard(const EpochAVL& t) {
+			size_t i = std::hash<std::thread::id>()(std::this_thread::get_id());
+			for (;; ++i) {
+				slot = &t.slots[i % READER_SLOTS];
+				if (!slot->busy.load(std::memory_order_relaxed)
+						&& !slot->busy.exchange(true, std::memory_order_acquire))
+					break;
+				if (i % READER_SLOTS == READER_SLOTS - 1)
+					std::this_thread::yield();
+			}
+			slot->epoch.store(t.epoch.load(std::memory_order_seq_cst),
+					std::memory_order_seq_cst);
+			root = t.published.load(std::memory_order_seq_cst);
+		}
+
+		~read_guard() {
+			slot->epoch.store(0, std::memory_order_release);
+			slot->busy.store(false, std::memory_order_release);
+		}
+
+		read_guard(const read_guard&) = delete;
+		read_guard& operator=(const read_guard&) = delete;
+
+		/* Same as AVL::find(). */
+		iterator find(const Key& k) const {
+			ancestors path;
+			Node* found = Base::find_path(k, root, path);
+			return Base::iterator_at(found, path);
+		}
+
+		/* Same as AVL::lower_bound(). */
+		iterator lower_bound(const Key& k) const {
+			ancestors path;
+			Node* found = Base::bound(k, root, false, path);
+			return Base::iterator_at(found, path);
+		}
+
+		/* Same as AVL::upper_bound(). */
+		iterator upper_bound(const Key& k) const {
+			ancestors path;
+			Node* found = Base::bound(k, root, true, path);
+			return Base::iterator_at(found, path);
+		}
+
+		/* Same as AVL::begin(). */
+		iterator begin() const {
+			ancestors path;
+			Node* first = root;
+			while (first && first->left) {
+				path.push(first);
+				first = first->left;
+			}
+			return Base::iterator_at(first, path);
+		}
+
+		iterator end() const {
+			return Base::iterator_at(NULL, ancestors());
+		}
+
+		bool empty() const {
+			return !root;
+		}
+	};
+
+	/* Default C'tor. Creates empty tree.
+	 * @Time complexity: O(1)
+	 */
+	EpochAVL() : published(NULL), epoch(1) {}
+
+	EpochAVL(const EpochAVL&) = delete;
+	EpochAVL& operator=(const EpochAVL&) = delete;
+
+	/* Frees all nodes. There must be no readers.
+	 * @Time complexity: O(n + r), where r is number of retired nodes.
+	 */
+	~EpochAVL() {
+		for (size_t i = 0; i < retired.size(); ++i) {
+			free_detached(retired[i].node, retired[i].value_taken);
+		}
+	}
+
+	/* Same as AVL::insert(). Readers see the item after it's published.
+	 *
+	 * @Return: true if item was inserted.
+	 * @Time complexity: O(log(n)) expected, plus amortized reclamation.
+	 * @Memory complexity: O(log(n))
+	 */
+	bool insert(const Key& k, const Value& v) {
+		std::lock_guard<std::mutex> lock(writer);
+		if (Base::find_r(k, this->root))
+			return false;
+		Change c;
+		try {
+			c.inserted = new Node(k, v);
+			Base::update(c.inserted);
+			publish(insert_r(c.inserted, this->root, c), c);
+		} catch (...) {
+			abandon(c);
+			throw;
+		}
+		return true;
+	}
+
+	/* Same as AVL::remove(). Node and value are freed after readers, which
+	 * may see them, are done.
+	 *
+	 * @Time complexity: O(log(n)) expected, plus amortized reclamation.
+	 * @Memory complexity: O(log(n))
+	 */
+	void remove(const Key& k) {
+		std::lock_guard<std::mutex> lock(writer);
+		if (!Base::find_r(k, this->root))
+			return;
+		Change c;
+		try {
+			publish(remove_r(k, this->root, c), c);
+		} catch (...) {
+			abandon(c);
+			throw;
+		}
+	}
+
+	/* Removes all items. Nodes are freed after current readers are done.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(n)
+	 */
+	void clear() {
+		std::lock_guard<std::mutex> lock(writer);
+		Change c;
+		nodes_r(this->root, c.removed);
+		publish(NULL, c);
+	}
+
+	/* Frees retired nodes, which readers can't reach anymore. Called by
+	 * changes too, once in RECLAIM_BATCH retired nodes.
+	 * @Time complexity: O(r + READER_SLOTS), where r is number of retired.
+	 */
+	void reclaim() {
+		std::lock_guard<std::mutex> lock(writer);
+		reclaim_retired();
+	}
+
+	/* @Return: number of retired nodes, which aren't freed yet. */
+	int retired_count() {
+		std::lock_guard<std::mutex> lock(writer);
+		return retired.size();
+	}
+};
+
+#endif /* EPOCHAVL_HPP_ */
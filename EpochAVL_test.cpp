@@ -0,0 +1,130 @@
+/*
+ * EpochAVL_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "EpochAVL.hpp"
+
+typedef EpochAVL<int, std::string> Tree;
+
+static void expect_same(const Tree& tree, const std::map<int, std::string>& reference) {
+	Tree::read_guard guard(tree);
+	auto expected = reference.begin();
+	for (auto it = guard.begin(); it != guard.end(); ++it, ++expected) {
+		ASSERT_EQ(it.key(), expected->first);
+		ASSERT_EQ(*it, expected->second);
+	}
+	ASSERT_TRUE(expected == reference.end());
+}
+
+TEST(EpochAVL, random_against_map) {
+	Tree tree;
+	std::map<int, std::string> reference;
+	unsigned int seed = 7;
+	for (int i = 0; i < 20000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		int k = (seed >> 16) % 1000;
+		if ((seed >> 8) % 2) {
+			bool inserted = reference.insert(std::make_pair(k,
+					std::to_string(i))).second;
+			ASSERT_EQ(tree.insert(k, std::to_string(i)), inserted);
+		} else {
+			reference.erase(k);
+			tree.remove(k);
+		}
+		if (i % 1000 == 0)
+			expect_same(tree, reference);
+	}
+	expect_same(tree, reference);
+	Tree::read_guard guard(tree);
+	for (int k = 0; k < 1000; ++k) {
+		ASSERT_EQ(guard.find(k) == guard.end(), !reference.count(k));
+	}
+	ASSERT_EQ(guard.lower_bound(-1).key(), reference.begin()->first);
+	ASSERT_EQ(guard.upper_bound(1000), guard.end());
+}
+
+TEST(EpochAVL, guard_keeps_its_version) {
+	Tree tree;
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i, std::to_string(i));
+	}
+	{
+		Tree::read_guard guard(tree);
+		Tree::iterator it = guard.find(50);
+		for (int i = 0; i < 100; i += 2) {
+			tree.remove(i);
+		}
+		tree.reclaim();
+		ASSERT_GT(tree.retired_count(), 0);
+		// Removed items are still there for the guard.
+		ASSERT_EQ(*it, "50");
+		int count = 0;
+		for (it = guard.begin(); it != guard.end(); ++it) {
+			++count;
+		}
+		ASSERT_EQ(count, 100);
+		Tree::read_guard later(tree);
+		ASSERT_EQ(later.find(50), later.end());
+		ASSERT_EQ(*later.find(51), "51");
+	}
+	tree.reclaim();
+	ASSERT_EQ(tree.retired_count(), 0);
+	tree.clear();
+	Tree::read_guard guard(tree);
+	ASSERT_TRUE(guard.empty());
+}
+
+/* Single writer changes the tree, while readers check that every version
+ * they see is sorted, and has values consistent with keys. */
+TEST(EpochAVL, concurrent_readers) {
+	EpochAVL<int, int> tree;
+	for (int i = 0; i < 1000; ++i) {
+		tree.insert(i, i * 2);
+	}
+	std::atomic<bool> done(false);
+	std::atomic<int> errors(0);
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; ++r) {
+		readers.push_back(std::thread([&tree, &done, &errors, r]() {
+			int k = r;
+			while (!done.load()) {
+				EpochAVL<int, int>::read_guard guard(tree);
+				int previous = -1;
+				for (auto it = guard.lower_bound(k); it != guard.end(); ++it) {
+					if (*it != it.key() * 2 || it.key() <= previous)
+						++errors;
+					previous = it.key();
+				}
+				auto it = guard.find(k);
+				if (it != guard.end() && *it != k * 2)
+					++errors;
+				k = (k + 37) % 1000;
+			}
+		}));
+	}
+	unsigned int seed = 11;
+	for (int i = 0; i < 20000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		int k = (seed >> 16) % 1000;
+		if ((seed >> 8) % 2) {
+			tree.insert(k, k * 2);
+		} else {
+			tree.remove(k);
+		}
+	}
+	done = true;
+	for (size_t r = 0; r < readers.size(); ++r) {
+		readers[r].join();
+	}
+	ASSERT_EQ(errors.load(), 0);
+	tree.reclaim();
+	ASSERT_EQ(tree.retired_count(), 0);
+}
@@ -0,0 +1,301 @@
+/*
+ * HashedAVL.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef HASHEDAVL_HPP_
+#define HASHEDAVL_HPP_
+
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include "AVL.hpp"
+
+namespace aux {
+/* Keys equality by operator<, so hashed keys need no operator==. */
+template<typename Key>
+struct key_equal {
+	bool operator()(const Key& a, const Key& b) const {
+		return !(a < b || b < a);
+	}
+};
+}
+
+/* AVL tree with a side hash index from keys to nodes, for O(1) point
+ * lookups. Ordered iteration, bounds and ranges still use the tree.
+ * Index is kept in sync by all changing operations. Operations, which
+ * rebuild the tree (merge, compact, load, assign_sorted), rebuild it too.
+ * Tree is inherited privately, so it can't be changed through AVL& behind
+ * the index; its read-only operations are re-exported.
+ *
+ * Costs O(n) extra memory, and a hash table update in each insertion and
+ * removal.
+ *
+ * @Requirements from Key: same as in AVL, and Hash, which is consistent
+ *     with operator< (equal keys have equal hashes).
+ * @Requirements from Value: same as in AVL.
+ */
+template<typename Key, typename Value, typename Hash = std::hash<Key> >
+class HashedAVL: private AVL<Key, Value> {
+	typedef AVL<Key, Value> Base;
+	typedef typename Base::Node Node;
+	typedef std::unordered_map<Key, Node*, Hash, aux::key_equal<Key> > Index;
+
+	Index index;
+
+	/* Adds all nodes of subtree r to the index.
+	 * @Time complexity: O(n)
+	 * @Memory complexity: O(log(n))
+	 */
+	void index_r(Node* r) {
+		if (!r)
+			return;
+		index[r->key] = r;
+		index_r(r->left);
+		index_r(r->right);
+	}
+
+	/* Rebuilds the index after the tree was rebuilt.
+	 * @Time complexity: O(n)
+	 */
+	void reindex() {
+		index.clear();
+		index_r(this->root);
+	}
+
+	/* Unlinks node n with key k, which is in the tree, and updates index.
+	 * When n has two children, unlink_r moves the item of its successor
+	 * into n, and unlinks the successor's node instead (holding k).
+	 *
+	 * @Return: unlinked node, holding key k.
+	 * @Time complexity: O(log(n))
+	 */
+	Node* unlink(const Key& k, Node* n) {
+		Node* next = n->left && n->right ? Base::leftmost(n->right) : NULL;
+		Node* unlinked = NULL;
+		this->root = Base::unlink_r(k, this->root, unlinked);
+		index.erase(k);
+		if (next)
+			index[n->key] = n;
+		return unlinked;
+	}
+
+public:
+	typedef typename Base::iterator iterator;
+	typedef typename Base::node_handle node_handle;
+
+	using Base::begin;
+	using Base::end;
+	using Base::empty;
+	using Base::lower_bound;
+	using Base::upper_bound;
+	using Base::memory_usage;
+	using Base::save;
+#ifdef AVL_ENABLE_STATS
+	using Base::depth_histogram;
+	using Base::stats;
+	using Base::reset_stats;
+#endif
+
+	/* Default C'tor. Creates empty tree.
+	 * @Time complexity: O(1)
+	 */
+	HashedAVL() {}
+
+	/* Copy C'tor.
+	 * @Time complexity: O(m), where m is number of nodes in tree t.
+	 * @Memory complexity: O(m)
+	 */
+	HashedAVL(const HashedAVL& t) : Base(t) {
+		reindex();
+	}
+
+	/* Move C'tor. Takes all nodes of t, which is left empty.
+	 * @Time complexity: O(1)
+	 */
+	HashedAVL(HashedAVL&& t) : Base(std::move(t)), index(std::move(t.index)) {
+		t.index.clear();
+	}
+
+	HashedAVL& operator=(const HashedAVL& t) {
+		if (this != &t) {
+			Base::operator=(t);
+			reindex();
+		}
+		return *this;
+	}
+
+	HashedAVL& operator=(HashedAVL&& t) {
+		if (this != &t) {
+			Base::operator=(std::move(t));
+			index = std::move(t.index);
+			t.index.clear();
+		}
+		return *this;
+	}
+
+	/* Searches the index for item with key k.
+	 *
+	 * @Return: in-order iterator to element with key k, or iterator to end()
+	 *     if item isn't present.
+	 * @Time complexity: O(1) expected.
+	 */
+	iterator find(const Key& k) const {
+		typename Index::const_iterator it = index.find(k);
+		return it == index.end() ? this->end() : Base::iterator_at(it->second);
+	}
+
+	/* @Return: number of items in tree.
+	 * @Time complexity: O(1)
+	 */
+	int size() const {
+		return index.size();
+	}
+
+	/* Same as AVL::insert(). Index entry is made first, so if anything
+	 * throws, it's rolled back, and the tree is unchanged.
+	 * @Time complexity: O(log(n)), existing key is found in O(1) expected.
+	 * @Memory complexity: O(log(n))
+	 */
+	bool insert(const Key& k, const Value& v) {
+		std::pair<typename Index::iterator, bool> entry = index.insert(
+				std::make_pair(k, (Node*) NULL));
+		if (!entry.second)
+			return false;
+		try {
+			entry.first->second = new Node(k, v);
+		} catch (...) {
+			index.erase(entry.first);
+			throw;
+		}
+		this->root = Base::insert_r(entry.first->second, this->root);
+		return true;
+	}
+
+	/* Same as AVL::insert(node_handle&&). If index entry can't be made,
+	 * h keeps the node.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	bool insert(node_handle&& h) {
+		if (h.empty())
+			return false;
+		std::pair<typename Index::iterator, bool> entry = index.insert(
+				std::make_pair(h.key(), (Node*) NULL));
+		if (!entry.second)
+			return false;
+		entry.first->second = Base::release(h);
+		this->root = Base::insert_r(entry.first->second, this->root);
+		return true;
+	}
+
+	/* Same as AVL::extract().
+	 * @Time complexity: O(log(n)), missing key is found in O(1) expected.
+	 * @Memory complexity: O(log(n))
+	 */
+	node_handle extract(const Key& k) {
+		typename Index::iterator it = index.find(k);
+		if (it == index.end())
+			return node_handle();
+		return Base::handle_of(unlink(k, it->second));
+	}
+	node_handle extract(const iterator& it) {
+		return extract(it.key());
+	}
+
+	/* Same as AVL::remove().
+	 * @Time complexity: O(log(n)), missing key is found in O(1) expected.
+	 * @Memory complexity: O(log(n))
+	 */
+	void remove(const Key& k) {
+		typename Index::iterator it = index.find(k);
+		if (it != index.end())
+			Base::free_node(unlink(k, it->second));
+	}
+
+	/* Same as AVL::erase_range().
+	 * @Time complexity: O(log(n) + k), where k is number of removed elements.
+	 * @Memory complexity: O(log(n))
+	 */
+	int erase_range(const Key& lo, const Key& hi) {
+		for (iterator it = this->lower_bound(lo); it != this->end()
+				&& it.key() < hi; ++it) {
+			index.erase(it.key());
+		}
+		return Base::erase_range(lo, hi);
+	}
+
+	/* Same as AVL::extract_range(), returns plain AVL tree.
+	 * @Time complexity: O(log(n) + k), where k is number of removed elements.
+	 * @Memory complexity: O(log(n))
+	 */
+	Base extract_range(const Key& lo, const Key& hi) {
+		for (iterator it = this->lower_bound(lo); it != this->end()
+				&& it.key() < hi; ++it) {
+			index.erase(it.key());
+		}
+		return Base::extract_range(lo, hi);
+	}
+
+	/* Same as AVL::clear().
+	 * @Time complexity: O(n)
+	 */
+	void clear() {
+		Base::clear();
+		index.clear();
+	}
+
+	/* Same as AVL::merge(), index is rebuilt.
+	 * @Time complexity: O(m+n)
+	 * @Memory complexity: O(m+n)
+	 */
+	void merge(const Base& t) {
+		Base::merge(t);
+		reindex();
+	}
+	void merge(const HashedAVL& t) {
+		merge(static_cast<const Base&>(t));
+	}
+
+	/* Same as AVL::compact(), index is rebuilt.
+	 * @Time complexity: O(n), O(n*log(log(n))) for COMPACT_VEB.
+	 * @Memory complexity: O(n)
+	 */
+	void compact(CompactOrder order = COMPACT_INORDER) {
+		Base::compact(order);
+		reindex();
+	}
+
+	/* Same as AVL::load(), index is rebuilt.
+	 * @Time complexity: O(n + m)
+	 */
+	template<typename KeyCodec = BinaryCodec<Key>,
+			typename ValueCodec = BinaryCodec<Value> >
+	bool load(std::istream& is) {
+		bool ok = Base::template load<KeyCodec, ValueCodec>(is);
+		reindex();
+		return ok;
+	}
+
+	/* Same as AVL::assign_sorted(), index is rebuilt.
+	 * @Time complexity: O(n + m)
+	 */
+	template<typename ForwardIt>
+	void assign_sorted(ForwardIt first, ForwardIt last) {
+		Base::assign_sorted(first, last);
+		reindex();
+	}
+
+	/* Same as AVL::build_parallel(), index is rebuilt.
+	 * @Time complexity: O(n + p*log(p)/t + p)
+	 * @Memory complexity: O(p)
+	 */
+	template<typename ForwardIt>
+	void build_parallel(ForwardIt first, ForwardIt last, unsigned threads = 0) {
+		Base::build_parallel(first, last, threads);
+		reindex();
+	}
+};
+
+#endif /* HASHEDAVL_HPP_ */
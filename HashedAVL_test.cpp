@@ -0,0 +1,163 @@
+/*
+ * HashedAVL_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <map>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <gtest/gtest.h>
+#include "HashedAVL.hpp"
+
+/* Checks that every key of reference is found, with node of the tree, and
+ * that the tree holds exactly items of reference. */
+static void expect_same(const HashedAVL<int, int>& tree,
+		const std::map<int, int>& reference) {
+	ASSERT_EQ(tree.size(), (int) reference.size());
+	auto expected = reference.begin();
+	for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+		ASSERT_EQ(it.key(), expected->first);
+		ASSERT_EQ(*it, expected->second);
+		ASSERT_EQ(tree.find(it.key()), it);
+	}
+}
+
+TEST(HashedAVL, random_against_map) {
+	HashedAVL<int, int> tree;
+	std::map<int, int> reference;
+	unsigned int seed = 3;
+	for (int i = 0; i < 20000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		int k = (seed >> 16) % 1000;
+		if ((seed >> 8) % 2) {
+			bool inserted = reference.insert(std::make_pair(k, i)).second;
+			ASSERT_EQ(tree.insert(k, i), inserted);
+		} else {
+			reference.erase(k);
+			tree.remove(k);
+		}
+		if (i % 500 == 0)
+			expect_same(tree, reference);
+	}
+	expect_same(tree, reference);
+	for (int k = 0; k < 1000; ++k) {
+		ASSERT_EQ(tree.find(k) == tree.end(), !reference.count(k));
+	}
+}
+
+TEST(HashedAVL, remove_node_with_two_children) {
+	HashedAVL<int, int> tree;
+	for (int i = 1; i <= 7; ++i) {
+		tree.insert(i, i * 10);
+	}
+	tree.remove(4); // root, its successor's item moves into it
+	ASSERT_EQ(tree.find(4), tree.end());
+	ASSERT_EQ(*tree.find(5), 50);
+	tree.remove(5);
+	ASSERT_EQ(*tree.find(6), 60);
+	ASSERT_EQ(tree.size(), 5);
+}
+
+TEST(HashedAVL, node_handles) {
+	HashedAVL<int, int> tree;
+	for (int i = 0; i < 10; ++i) {
+		tree.insert(i, i);
+	}
+	HashedAVL<int, int>::node_handle h = tree.extract(3);
+	ASSERT_FALSE(h.empty());
+	ASSERT_EQ(tree.find(3), tree.end());
+	ASSERT_TRUE(tree.extract(3).empty());
+	h.key() = 30;
+	ASSERT_TRUE(tree.insert(std::move(h)));
+	ASSERT_EQ(*tree.find(30), 3);
+	h = tree.extract(tree.find(5));
+	ASSERT_EQ(h.value(), 5);
+	ASSERT_EQ(tree.size(), 9);
+}
+
+TEST(HashedAVL, ranges_and_rebuilds) {
+	HashedAVL<int, int> tree;
+	std::map<int, int> reference;
+	for (int i = 0; i < 100; ++i) {
+		tree.insert(i, i);
+		reference[i] = i;
+	}
+	ASSERT_EQ(tree.erase_range(10, 20), 10);
+	reference.erase(reference.find(10), reference.find(20));
+	AVL<int, int> extracted = tree.extract_range(30, 40);
+	ASSERT_EQ(extracted.size(), 10);
+	reference.erase(reference.find(30), reference.find(40));
+	expect_same(tree, reference);
+	AVL<int, int> other;
+	for (int i = 100; i < 120; ++i) {
+		other.insert(i, i);
+		reference[i] = i;
+	}
+	tree.merge(other);
+	expect_same(tree, reference);
+	tree.compact(COMPACT_VEB);
+	expect_same(tree, reference);
+	HashedAVL<int, int> copy(tree);
+	tree.clear();
+	ASSERT_EQ(tree.find(50), tree.end());
+	expect_same(copy, reference);
+	HashedAVL<int, int> moved(std::move(copy));
+	expect_same(moved, reference);
+	ASSERT_EQ(copy.find(50), copy.end());
+	tree.insert(1000, 1000);
+	reference[1000] = 1000;
+	tree.merge(moved);
+	expect_same(tree, reference);
+	// Tree can't be changed behind the index
+	static_assert(!std::is_convertible<HashedAVL<int, int>&,
+			AVL<int, int>&>::value, "tree is exposed");
+}
+
+/* Value, which fails to copy on demand. */
+struct FragileValue {
+	static bool fail;
+	FragileValue() {}
+	FragileValue(const FragileValue&) {
+		if (fail)
+			throw std::bad_alloc();
+	}
+};
+bool FragileValue::fail = false;
+
+TEST(HashedAVL, failed_insert_leaves_no_index_entry) {
+	HashedAVL<int, FragileValue> tree;
+	ASSERT_TRUE(tree.insert(1, FragileValue()));
+	FragileValue::fail = true;
+	ASSERT_THROW(tree.insert(2, FragileValue()), std::bad_alloc);
+	FragileValue::fail = false;
+	ASSERT_EQ(tree.size(), 1);
+	ASSERT_EQ(tree.find(2), tree.end());
+	ASSERT_TRUE(tree.insert(2, FragileValue()));
+	ASSERT_EQ(tree.size(), 2);
+}
+
+TEST(HashedAVL, string_keys) {
+	HashedAVL<std::string, int> tree;
+	tree.insert("b", 2);
+	tree.insert("a", 1);
+	ASSERT_EQ(*tree.find("a"), 1);
+	ASSERT_EQ(tree.begin().key(), "a");
+	ASSERT_EQ(tree.find("c"), tree.end());
+}
+
+TEST(HashedAVL, build_parallel) {
+	std::vector<std::pair<int, int> > items;
+	std::map<int, int> reference;
+	for (int i = 0; i < 50000; ++i) {
+		items.push_back(std::make_pair(i * 7919 % 30000, i));
+		reference.insert(items.back());
+	}
+	HashedAVL<int, int> tree;
+	tree.insert(-1, -1);
+	tree.build_parallel(items.begin(), items.end(), 4);
+	expect_same(tree, reference);
+	ASSERT_EQ(tree.find(-1), tree.end());
+}
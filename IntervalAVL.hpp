@@ -0,0 +1,188 @@
+/*
+ * IntervalAVL.hpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#ifndef INTERVALAVL_HPP_
+#define INTERVALAVL_HPP_
+
+#include <vector>
+#include "AVL.hpp"
+
+/* Half-open interval [lo, hi) of points.
+ * Intervals are ordered by lo, then by hi.
+ *
+ * @Requirements from Point: has operator< implemented, copy-constructible,
+ *     assignable, default-constructible.
+ */
+template<typename Point>
+struct Interval {
+	Point lo, hi;
+	Interval() : lo(), hi() {}
+	Interval(const Point& lo, const Point& hi) : lo(lo), hi(hi) {}
+};
+
+template<typename Point>
+bool operator<(const Interval<Point>& a, const Interval<Point>& b) {
+	return a.lo < b.lo || (!(b.lo < a.lo) && a.hi < b.hi);
+}
+
+/* Augmentation policy of interval tree: maximal end point in a subtree.
+ * identity() is only needed for aggregate() queries, and requires Point to
+ * have std::numeric_limits defined.
+ */
+template<typename Point>
+struct IntervalEndAugment {
+	typedef Point value_type;
+	static Point identity() {
+		return std::numeric_limits<Point>::lowest();
+	}
+	template<typename Value>
+	static Point lift(const Interval<Point>& k, const Value&) {
+		return k.hi;
+	}
+	static Point combine(const Point& a, const Point& b) {
+		return a < b ? b : a;
+	}
+};
+
+/* Interval tree: AVL tree keyed by intervals, where each node caches the
+ * maximal end point of its subtree. Cached end points are maintained by AVL
+ * itself (see Augment policy), including rolls, so all AVL operations are
+ * available as is.
+ * Intervals are keys, so same interval (equal lo and hi) can't be inserted
+ * twice: second insert() fails and returns false. Items of an interval,
+ * which may repeat, are kept together in its value (e.g. a vector).
+ *
+ * Overlap queries skip subtrees which end before the queried range, and
+ * right subtrees of nodes which start after it. Intervals, which start
+ * before the range end, form an in-order prefix of the tree. Inside it,
+ * each visited subtree has an overlap (its maximal end proves it), so
+ * visited nodes are paths to reported ones: O(log(n) + k*log(n/k)) for k
+ * reported intervals, not O(log(n) + k), which needs a different structure
+ * (e.g. centered interval tree).
+ *
+ * @Requirements from Point: same as in Interval.
+ * @Requirements from Value: same as in AVL.
+ */
+template<typename Point, typename Value>
+class IntervalAVL: public AVL<Interval<Point>, Value, IntervalEndAugment<Point> > {
+	typedef AVL<Interval<Point>, Value, IntervalEndAugment<Point> > Base;
+	typedef typename Base::Node Node;
+
+public:
+	typedef typename Base::iterator iterator;
+
+private:
+	/* Checks whether interval starting at point a starts before the end
+	 * of queried range. If inclusive, range end belongs to the range.
+	 * @Time complexity: O(1)
+	 */
+	static bool starts_before(const Point& a, const Point& hi, bool inclusive) {
+		return inclusive ? !(hi < a) : a < hi;
+	}
+
+	/* Recursively reports (in-order) all intervals of subtree r, which
+	 * overlap range [lo, hi) (or [lo, hi] if inclusive). Subtree is entered
+	 * only if its maximal end is after lo, and right subtree - only if r
+	 * starts before hi.
+	 *
+	 * @Time complexity: O(log(n) + k*log(n/k)), where k is number of
+	 *     reported intervals.
+	 * @Memory complexity: O(log(n))
+	 */
+	template<typename Function>
+	static void overlapping_r(const Point& lo, const Point& hi, bool inclusive,
+			Node* r, Function& f) {
+		if (!r || !(lo < r->aggregate))
+			return;
+		overlapping_r(lo, hi, inclusive, r->left, f);
+		if (!starts_before(r->key.lo, hi, inclusive))
+			return; // so do all intervals of the right subtree
+		if (lo < r->key.hi)
+			f(Base::iterator_at(r));
+		overlapping_r(lo, hi, inclusive, r->right, f);
+	}
+
+	/* Collects iterators into a vector. */
+	struct Collector {
+		std::vector<iterator>& out;
+		Collector(std::vector<iterator>& out) : out(out) {}
+		void operator()(const iterator& it) {
+			out.push_back(it);
+		}
+	};
+
+public:
+	/* Default C'tor. Creates empty tree.
+	 * @Time complexity: O(1)
+	 */
+	IntervalAVL() {}
+
+	/* Inserts interval [lo, hi) with value v.
+	 * If interval is already present - tree stays unchanged, and false returned
+	 * (same interval can't be inserted twice).
+	 *
+	 * @Return: false if interval is in tree.
+	 * @Time complexity: O(log(n))
+	 * @Memory complexity: O(log(n))
+	 */
+	bool insert(const Point& lo, const Point& hi, const Value& v) {
+		return Base::insert(Interval<Point>(lo, hi), v);
+	}
+	using Base::insert;
+
+	/* Calls f(iterator) for each interval, that overlaps [lo, hi), in-order.
+	 * For empty range (!(lo < hi)) nothing is reported.
+	 * Tree must not be changed by f.
+	 *
+	 * @Time complexity: O(log(n) + k*log(n/k)), where k is number of
+	 *     reported intervals. Subtrees without overlaps are skipped, so
+	 *     it's O(log(n) + k) when reported intervals are adjacent in-order
+	 *     (e.g. for non-nested intervals).
+	 * @Memory complexity: O(log(n))
+	 */
+	template<typename Function>
+	void for_each_overlapping(const Point& lo, const Point& hi, Function f) const {
+		if (lo < hi)
+			overlapping_r(lo, hi, false, this->root, f);
+	}
+
+	/* Calls f(iterator) for each interval, that contains point p, in-order.
+	 * Tree must not be changed by f.
+	 *
+	 * @Time complexity: same as above.
+	 * @Memory complexity: O(log(n))
+	 */
+	template<typename Function>
+	void for_each_overlapping(const Point& p, Function f) const {
+		overlapping_r(p, p, true, this->root, f);
+	}
+
+	/* Finds all intervals, that overlap [lo, hi).
+	 *
+	 * @Return: iterators to overlapping intervals, sorted.
+	 * @Time complexity: same as above.
+	 * @Memory complexity: O(log(n) + k)
+	 */
+	std::vector<iterator> overlapping(const Point& lo, const Point& hi) const {
+		std::vector<iterator> result;
+		for_each_overlapping(lo, hi, Collector(result));
+		return result;
+	}
+
+	/* Finds all intervals, that contain point p.
+	 *
+	 * @Return: iterators to intervals, sorted.
+	 * @Time complexity: same as above.
+	 * @Memory complexity: O(log(n) + k)
+	 */
+	std::vector<iterator> overlapping(const Point& p) const {
+		std::vector<iterator> result;
+		for_each_overlapping(p, Collector(result));
+		return result;
+	}
+};
+
+#endif /* INTERVALAVL_HPP_ */
@@ -0,0 +1,82 @@
+/*
+ * IntervalAVL_test.cpp
+ *
+ *  Created on: 2026-10-18
+ *      Author: Lev Pechersky
+ */
+#include <vector>
+#include <gtest/gtest.h>
+#include "IntervalAVL.hpp"
+
+typedef IntervalAVL<int, int> interval_tree;
+
+static std::vector<int> values_of(const std::vector<interval_tree::iterator>& v) {
+	std::vector<int> result;
+	for (auto it : v) {
+		result.push_back(*it);
+	}
+	return result;
+}
+
+TEST(IntervalAVL, empty_tree_no_overlaps) {
+	interval_tree tree;
+	ASSERT_TRUE(tree.overlapping(0, 10).empty());
+	ASSERT_TRUE(tree.overlapping(3).empty());
+}
+
+TEST(IntervalAVL, point_query) {
+	interval_tree tree;
+	tree.insert(0, 10, 1);
+	tree.insert(5, 8, 2);
+	tree.insert(10, 20, 3);
+	tree.insert(15, 16, 4);
+	ASSERT_EQ(values_of(tree.overlapping(5)), std::vector<int>({ 1, 2 }));
+	ASSERT_EQ(values_of(tree.overlapping(10)), std::vector<int>({ 3 }));
+	ASSERT_EQ(values_of(tree.overlapping(15)), std::vector<int>({ 3, 4 }));
+	ASSERT_TRUE(tree.overlapping(20).empty());
+	ASSERT_TRUE(tree.overlapping(-1).empty());
+}
+
+TEST(IntervalAVL, range_query_half_open) {
+	interval_tree tree;
+	tree.insert(0, 10, 1);
+	tree.insert(10, 20, 2);
+	tree.insert(20, 30, 3);
+	ASSERT_EQ(values_of(tree.overlapping(10, 20)), std::vector<int>({ 2 }));
+	ASSERT_EQ(values_of(tree.overlapping(9, 21)), std::vector<int>({ 1, 2, 3 }));
+	ASSERT_TRUE(tree.overlapping(12, 12).empty());
+}
+
+TEST(IntervalAVL, duplicate_interval_rejected) {
+	interval_tree tree;
+	ASSERT_TRUE(tree.insert(0, 10, 1));
+	ASSERT_FALSE(tree.insert(0, 10, 2));
+	ASSERT_TRUE(tree.insert(0, 11, 2));
+}
+
+TEST(IntervalAVL, random_against_linear_scan) {
+	interval_tree tree;
+	unsigned int seed = 11;
+	for (int i = 0; i < 3000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		int lo = (seed / 65536) % 1000;
+		seed = seed * 1103515245 + 12345;
+		int len = 1 + (seed / 65536) % 50;
+		if (i % 4 == 3) {
+			tree.remove(Interval<int>(lo, lo + len));
+		} else {
+			tree.insert(lo, lo + len, i);
+		}
+		if (i % 10)
+			continue;
+		std::vector<int> expected_range, expected_point;
+		for (auto it = tree.begin(); it != tree.end(); ++it) {
+			if (it.key().lo < lo + len && lo < it.key().hi)
+				expected_range.push_back(*it);
+			if (!(lo < it.key().lo) && lo < it.key().hi)
+				expected_point.push_back(*it);
+		}
+		ASSERT_EQ(values_of(tree.overlapping(lo, lo + len)), expected_range);
+		ASSERT_EQ(values_of(tree.overlapping(lo)), expected_point);
+	}
+}